@@ -1,177 +1,1930 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CAL_X86 1
+#endif
 
-#define MAXBUF 1024
+#define OUTBUF (1 << 20)   // stdio and read() buffer size for input
+#define MAX_VARS 16        // variables per expression
+#define MAX_VAR_NAME 32    // including the terminating NUL
+#define BLOCK 256          // rows per step of the column evaluator
+#define CHUNK (4 << 20)    // input bytes per batch work unit
+#define RESULT_MAX 320     // longest formatted result ("%.0f" of DBL_MAX)
+#define MAX_NESTING 256    // parenthesis depth accepted by the parser
+#define CACHE_SIZE 4096    // compiled programs kept by the server (power of two)
+#define MAX_CLIENTS 64     // concurrent socket connections in server mode
+#define CLIENT_LINE_MAX (1 << 20) // longest request line a socket client may send
+#define CLIENT_OUT_MAX (1 << 20)  // unsent reply bytes before a client's input is paused
+#define SINK_BUF (1 << 20) // output bytes collected before each write()
 
 // ---------------- Token types ----------------
 typedef enum {
-    T_NUMBER, T_PLUS, T_MINUS, T_STAR, T_SLASH,
-    T_LPAREN, T_RPAREN, T_EOF, T_INVALID
+    T_NUMBER, T_IDENT, T_PLUS, T_MINUS, T_STAR, T_SLASH,
+    T_LPAREN, T_RPAREN, T_EOF, T_INVALID,
+    T_BAD_NUMBER        // literal followed by a stray character; pos is that character
 } TokenType;
 
 typedef struct {
     TokenType type;
     double value;
+    size_t pos, len;    // where the token sits in the text
 } Token;
 
+// ---------------- Errors ----------------
+// Every stage reports failures as a status plus the byte offset in the
+// expression where it happened, so callers can record a bad line and go on.
+typedef enum {
+    CAL_OK,
+    CAL_ERR_UNEXPECTED,     // token does not fit the grammar here
+    CAL_ERR_SYNTAX,         // missing operand
+    CAL_ERR_DIV_ZERO,
+    CAL_ERR_UNKNOWN_VAR,    // variable with no binding
+    CAL_ERR_VARS,           // too many or too long variable names
+    CAL_ERR_NESTING,        // parentheses nested deeper than MAX_NESTING
+    CAL_EMPTY,              // blank line, only used in binary output
+    CAL_ERR_NUMBER          // malformed numeric literal
+} CalStatus;
+
+typedef struct {
+    CalStatus status;
+    size_t pos;
+} CalError;
+
+const char *cal_strerror(CalStatus status) {
+    switch (status) {
+        case CAL_OK:             return "ok";
+        case CAL_ERR_UNEXPECTED: return "Unexpected token";
+        case CAL_ERR_SYNTAX:     return "Syntax error: invalid factor";
+        case CAL_ERR_DIV_ZERO:   return "Division by zero";
+        case CAL_ERR_UNKNOWN_VAR: return "Unknown variable";
+        case CAL_ERR_VARS:       return "Too many or too long variable names";
+        case CAL_ERR_NESTING:    return "Parentheses nested too deeply";
+        case CAL_EMPTY:          return "Empty line";
+        case CAL_ERR_NUMBER:     return "Malformed number";
+    }
+    return "Unknown error";
+}
+
+// ---------------- Numbers ----------------
+// Decimal literals are read into a 64-bit mantissa and a power of ten.
+// When the mantissa fits in 53 bits and the power is within [-22, 22] both
+// are exact doubles, so one multiply or divide gives the correctly rounded
+// result (Clinger's fast path). That covers nearly all real input; the rest
+// (more than 19 significant digits, huge exponents, hex floats) goes to
+// strtod, which is also correctly rounded.
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define MAX_MANTISSA (1ULL << 53)
+
+// strtod on a literal that is not NUL-terminated.
+double number_slow(const char *s, size_t len) {
+    char buf[128];
+    char *tmp = len < sizeof(buf) ? buf : malloc(len + 1);
+    if (!tmp) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    memcpy(tmp, s, len);
+    tmp[len] = '\0';
+    double v = strtod(tmp, NULL);
+    if (tmp != buf) free(tmp);
+    return v;
+}
+
+int hex_digit(unsigned char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Scans an unsigned literal at s[0, len): 123, 1.5, .5, 2e-3, 0x1F, 0x1.8p3.
+// Stores the value and returns the number of bytes used, or 0 if s does not
+// start with a number.
+size_t scan_number(const char *s, size_t len, double *out) {
+    const unsigned char *p = (const unsigned char *)s;
+    const unsigned char *end = p + len;
+    uint64_t m = 0;
+
+    if (len > 2 && p[0] == '0' && (p[1] | 0x20) == 'x' && hex_digit(p[2]) >= 0) {
+        int nd = 0, d;
+        for (p += 2; p < end && (d = hex_digit(*p)) >= 0; p++, nd++) m = m * 16 + (uint64_t)d;
+        int is_float = p < end && (*p == '.' || (*p | 0x20) == 'p');
+        if (nd <= 16 && !is_float) {
+            *out = (double)m;   // a single correctly rounded conversion
+            return (size_t)(p - (const unsigned char *)s);
+        }
+        if (p < end && *p == '.')
+            for (p++; p < end && hex_digit(*p) >= 0; p++) {}
+        if (p + 1 < end && (*p | 0x20) == 'p') {
+            const unsigned char *q = p + 1;
+            if (q < end - 1 && (*q == '+' || *q == '-')) q++;
+            if (isdigit(*q))
+                for (p = q; p < end && isdigit(*p); p++) {}
+        }
+        size_t n = (size_t)(p - (const unsigned char *)s);
+        *out = number_slow(s, n);
+        return n;
+    }
+
+    int nd = 0;             // digits held in m
+    int digits = 0;         // digits seen at all
+    int truncated = 0;      // a non-zero digit did not fit in m
+    long exp10 = 0;
+
+    for (; p < end && isdigit(*p); p++, digits++) {
+        if (nd < 19) {
+            m = m * 10 + (uint64_t)(*p - '0');
+            if (m) nd++;
+        } else {
+            exp10++;
+            truncated |= *p != '0';
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isdigit(*p); p++, digits++) {
+            if (nd < 19) {
+                m = m * 10 + (uint64_t)(*p - '0');
+                if (m) nd++;
+                exp10--;
+            } else {
+                truncated |= *p != '0';
+            }
+        }
+    }
+    if (digits == 0) return 0;
+
+    if (p < end && (*p | 0x20) == 'e') {
+        const unsigned char *q = p + 1;
+        int neg = 0;
+        if (q < end && (*q == '+' || *q == '-')) neg = *q++ == '-';
+        if (q < end && isdigit(*q)) {
+            long e = 0;
+            for (; q < end && isdigit(*q); q++)
+                if (e < 100000) e = e * 10 + (*q - '0');
+            exp10 += neg ? -e : e;
+            p = q;
+        }
+    }
+
+    size_t n = (size_t)(p - (const unsigned char *)s);
+    if (!truncated && m <= MAX_MANTISSA) {
+        if (m == 0) {
+            *out = 0;
+            return n;
+        }
+        if (exp10 >= -22 && exp10 <= 22) {
+            *out = exp10 < 0 ? (double)m / pow10_exact[-exp10] : (double)m * pow10_exact[exp10];
+            return n;
+        }
+        // 123e25: move the excess power into the mantissa while it stays exact
+        if (exp10 > 22 && exp10 <= 22 + 15) {
+            uint64_t scaled = m;
+            long k = exp10 - 22;
+            while (k > 0 && scaled <= MAX_MANTISSA / 10) {
+                scaled *= 10;
+                k--;
+            }
+            if (k == 0) {
+                *out = (double)scaled * pow10_exact[22];
+                return n;
+            }
+        }
+    }
+    *out = number_slow(s, n);
+    return n;
+}
+
 // ---------------- Lexer ----------------
+// Scans text[0, len). The text need not be NUL-terminated, so the lexer can
+// run directly over a line of a memory-mapped file.
 typedef struct {
     const char *text;
+    size_t len;
     size_t pos;
     Token current;
 } Lexer;
 
 Token get_next_token(Lexer *lex) {
-    const char *t = lex->text;
-    while (isspace(t[lex->pos])) lex->pos++;
+    const unsigned char *t = (const unsigned char *)lex->text;
+    size_t len = lex->len;
+    while (lex->pos < len && isspace(t[lex->pos])) lex->pos++;
 
-    char c = t[lex->pos];
-    if (c == '\0') return (Token){T_EOF, 0};
+    size_t start = lex->pos;
+    if (start == len) return (Token){.type = T_EOF, .pos = start};
+    unsigned char c = t[start];
 
-    if (isdigit(c)) {
-        double val = 0;
-        while (isdigit(t[lex->pos])) {
-            val = val * 10 + (t[lex->pos] - '0');
-            lex->pos++;
-        }
-        return (Token){T_NUMBER, val};
+    if (isdigit(c) || (c == '.' && start + 1 < len && isdigit(t[start + 1]))) {
+        double val;
+        lex->pos += scan_number(lex->text + start, len - start, &val);
+        // 0x1.8.8, 1e or 2x: the literal stops short of what was written
+        size_t end = lex->pos;
+        if (end < len && (isalnum(t[end]) || t[end] == '_' || t[end] == '.'))
+            return (Token){.type = T_BAD_NUMBER, .pos = end, .len = 1};
+        return (Token){T_NUMBER, val, start, lex->pos - start};
+    }
+
+    if (isalpha(c) || c == '_') {
+        while (lex->pos < len && (isalnum(t[lex->pos]) || t[lex->pos] == '_')) lex->pos++;
+        return (Token){.type = T_IDENT, .pos = start, .len = lex->pos - start};
     }
 
     lex->pos++;
+    TokenType type;
     switch (c) {
-        case '+': return (Token){T_PLUS, 0};
-        case '-': return (Token){T_MINUS, 0};
-        case '*': return (Token){T_STAR, 0};
-        case '/': return (Token){T_SLASH, 0};
-        case '(': return (Token){T_LPAREN, 0};
-        case ')': return (Token){T_RPAREN, 0};
-        default:  return (Token){T_INVALID, 0};
+        case '+': type = T_PLUS; break;
+        case '-': type = T_MINUS; break;
+        case '*': type = T_STAR; break;
+        case '/': type = T_SLASH; break;
+        case '(': type = T_LPAREN; break;
+        case ')': type = T_RPAREN; break;
+        default:  type = T_INVALID; break;
+    }
+    return (Token){.type = type, .pos = start, .len = 1};
+}
+
+// ---------------- Program ----------------
+// A compiled expression: a flat RPN instruction array plus a constant pool.
+// Compiling once and running many times skips lexing and parsing entirely.
+typedef enum {
+    OP_PUSH,    // push consts[arg]
+    OP_VAR,     // push variable arg
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+    OP_TEE,     // copy the top of the stack into temp arg (no pop)
+    OP_LOAD     // push temp arg
+} OpCode;
+
+// For operators, arg is the operator's offset in the source text so that
+// run-time errors can point at it. Temps are only created by optimize().
+typedef struct {
+    uint32_t op;
+    uint32_t arg;
+} Instr;
+
+typedef struct {
+    Instr *code;
+    size_t len, cap;
+    double *consts;
+    size_t nconsts, cconsts;
+    char vars[MAX_VARS][MAX_VAR_NAME];  // variable names, index = OP_VAR arg
+    size_t var_pos[MAX_VARS];           // first use of each in the source
+    size_t nvars;
+    size_t ntemps;          // shared sub-expression results
+    double *stack;          // evaluation stack (max_depth entries) + temps
+    size_t depth, max_depth, cstack;
+    double *blocks;         // column evaluator scratch, BLOCK doubles per slot
+    size_t cblocks;
+    const double **slots;   // column evaluator stack, max_depth entries
+    size_t cslots;
+} Program;
+
+void program_init(Program *prog) {
+    memset(prog, 0, sizeof(*prog));
+}
+
+void program_free(Program *prog) {
+    free(prog->code);
+    free(prog->consts);
+    free(prog->stack);
+    free(prog->blocks);
+    free(prog->slots);
+    program_init(prog);
+}
+
+// Empties the program but keeps its buffers for the next compile.
+void program_reset(Program *prog) {
+    prog->len = 0;
+    prog->nconsts = 0;
+    prog->nvars = 0;
+    prog->ntemps = 0;
+    prog->depth = 0;
+    prog->max_depth = 0;
+}
+
+// Grows *buf so it holds at least `need` elements of `size` bytes.
+void *grow(void *buf, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap) return buf;
+    size_t ncap = *cap ? *cap : 16;
+    while (ncap < need) ncap *= 2;
+    buf = realloc(buf, ncap * size);
+    if (!buf) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    *cap = ncap;
+    return buf;
+}
+
+// Appends an instruction and tracks the stack depth it leaves behind.
+void emit(Program *prog, OpCode op, uint32_t arg) {
+    prog->code = grow(prog->code, &prog->cap, prog->len + 1, sizeof(Instr));
+    prog->code[prog->len++] = (Instr){op, arg};
+    if (op == OP_PUSH || op == OP_VAR || op == OP_LOAD) {
+        if (++prog->depth > prog->max_depth) prog->max_depth = prog->depth;
+    } else if (op != OP_TEE) {
+        prog->depth--;
+    }
+}
+
+void emit_const(Program *prog, double value) {
+    prog->consts = grow(prog->consts, &prog->cconsts, prog->nconsts + 1, sizeof(double));
+    prog->consts[prog->nconsts] = value;
+    emit(prog, OP_PUSH, (uint32_t)prog->nconsts++);
+}
+
+// Returns the index of variable `name`, or -1 if the program does not use it.
+int find_var(const Program *prog, const char *name, size_t len) {
+    for (size_t i = 0; i < prog->nvars; i++)
+        if (strncmp(prog->vars[i], name, len) == 0 && prog->vars[i][len] == '\0')
+            return (int)i;
+    return -1;
+}
+
+// Returns -1 if the variable table is full or the name is too long.
+int emit_var(Program *prog, const char *name, size_t len, size_t pos) {
+    int idx = find_var(prog, name, len);
+    if (idx < 0) {
+        if (prog->nvars == MAX_VARS || len >= MAX_VAR_NAME) return -1;
+        memcpy(prog->vars[prog->nvars], name, len);
+        prog->vars[prog->nvars][len] = '\0';
+        prog->var_pos[prog->nvars] = pos;
+        idx = (int)prog->nvars++;
+    }
+    emit(prog, OP_VAR, (uint32_t)idx);
+    return 0;
+}
+
+// Runs the program on a value stack, reading variable i from vars[i], and
+// stores the value in *result. The loop only dispatches on OpCode; the
+// single error check is the zero test in OP_DIV.
+CalError run_program(Program *prog, const double *vars, double *result) {
+    prog->stack = grow(prog->stack, &prog->cstack, prog->max_depth + 1 + prog->ntemps, sizeof(double));
+
+    const Instr *ip = prog->code;
+    const Instr *end = ip + prog->len;
+    const double *k = prog->consts;
+    double *sp = prog->stack;   // points at the top element
+    double *temps = prog->stack + prog->max_depth + 1;
+
+    for (; ip < end; ip++) {
+        switch ((OpCode)ip->op) {
+            case OP_PUSH: *++sp = k[ip->arg]; break;
+            case OP_VAR:  *++sp = vars[ip->arg]; break;
+            case OP_ADD:  sp[-1] += sp[0]; sp--; break;
+            case OP_SUB:  sp[-1] -= sp[0]; sp--; break;
+            case OP_MUL:  sp[-1] *= sp[0]; sp--; break;
+            case OP_DIV:
+                if (sp[0] == 0) return (CalError){CAL_ERR_DIV_ZERO, ip->arg};
+                sp[-1] /= sp[0]; sp--;
+                break;
+            case OP_TEE:  temps[ip->arg] = *sp; break;
+            case OP_LOAD: *++sp = temps[ip->arg]; break;
+        }
+    }
+    *result = *sp;
+    return (CalError){CAL_OK, 0};
+}
+
+// ---------------- Column evaluation ----------------
+// Runs one program over whole columns. The program is interpreted once per
+// BLOCK rows and every instruction is a tight SIMD loop over the block, so
+// the dispatch cost is spread over BLOCK values. Division by zero follows
+// IEEE rules here (inf/nan) rather than stopping the run.
+typedef void (*BlockKernel)(double *dst, const double *a, const double *b, size_t n);
+
+typedef struct {
+    BlockKernel op[OP_DIV + 1];   // indexed by OpCode, binary ops only
+} ColumnKernels;
+
+#define SCALAR_KERNEL(name, OPER)                                              \
+    static void name(double *dst, const double *a, const double *b, size_t n) { \
+        for (size_t i = 0; i < n; i++) dst[i] = a[i] OPER b[i];                \
+    }
+
+SCALAR_KERNEL(add_scalar, +)
+SCALAR_KERNEL(sub_scalar, -)
+SCALAR_KERNEL(mul_scalar, *)
+SCALAR_KERNEL(div_scalar, /)
+
+static const ColumnKernels kernels_scalar = {
+    .op = {[OP_ADD] = add_scalar, [OP_SUB] = sub_scalar,
+           [OP_MUL] = mul_scalar, [OP_DIV] = div_scalar}
+};
+
+#ifdef CAL_X86
+#define SSE2_KERNEL(name, INTRIN, OPER)                                        \
+    static void name(double *dst, const double *a, const double *b, size_t n) { \
+        size_t i = 0;                                                          \
+        for (; i + 2 <= n; i += 2)                                             \
+            _mm_storeu_pd(dst + i, INTRIN(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))); \
+        for (; i < n; i++) dst[i] = a[i] OPER b[i];                            \
+    }
+
+#define AVX2_KERNEL(name, INTRIN, OPER)                                        \
+    __attribute__((target("avx2")))                                            \
+    static void name(double *dst, const double *a, const double *b, size_t n) { \
+        size_t i = 0;                                                          \
+        for (; i + 8 <= n; i += 8) {                                           \
+            __m256d x0 = INTRIN(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)); \
+            __m256d x1 = INTRIN(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)); \
+            _mm256_storeu_pd(dst + i, x0);                                     \
+            _mm256_storeu_pd(dst + i + 4, x1);                                 \
+        }                                                                      \
+        for (; i < n; i++) dst[i] = a[i] OPER b[i];                            \
+    }
+
+SSE2_KERNEL(add_sse2, _mm_add_pd, +)
+SSE2_KERNEL(sub_sse2, _mm_sub_pd, -)
+SSE2_KERNEL(mul_sse2, _mm_mul_pd, *)
+SSE2_KERNEL(div_sse2, _mm_div_pd, /)
+AVX2_KERNEL(add_avx2, _mm256_add_pd, +)
+AVX2_KERNEL(sub_avx2, _mm256_sub_pd, -)
+AVX2_KERNEL(mul_avx2, _mm256_mul_pd, *)
+AVX2_KERNEL(div_avx2, _mm256_div_pd, /)
+
+static const ColumnKernels kernels_sse2 = {
+    .op = {[OP_ADD] = add_sse2, [OP_SUB] = sub_sse2,
+           [OP_MUL] = mul_sse2, [OP_DIV] = div_sse2}
+};
+
+static const ColumnKernels kernels_avx2 = {
+    .op = {[OP_ADD] = add_avx2, [OP_SUB] = sub_avx2,
+           [OP_MUL] = mul_avx2, [OP_DIV] = div_avx2}
+};
+#endif
+
+// Picks the widest kernel set the running CPU supports.
+const ColumnKernels *column_kernels(void) {
+#ifdef CAL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &kernels_avx2;
+    if (__builtin_cpu_supports("sse2")) return &kernels_sse2;
+#endif
+    return &kernels_scalar;
+}
+
+// Evaluates the program for rows [0, n): variable i is read from cols[i],
+// results go to out[0..n).
+void run_columns(Program *prog, const double *const *cols, size_t n, double *out) {
+    const ColumnKernels *kern = column_kernels();
+    size_t nslots = prog->max_depth + prog->nconsts + prog->ntemps;
+    prog->slots = grow(prog->slots, &prog->cslots, prog->max_depth + 1, sizeof(double *));
+    const double **stack = prog->slots;
+
+    // Slots [0, max_depth) hold intermediate results, then each constant
+    // broadcast across a block (filled once per call), then the temps.
+    prog->blocks = grow(prog->blocks, &prog->cblocks, nslots * BLOCK, sizeof(double));
+    double *consts = prog->blocks + prog->max_depth * BLOCK;
+    double *temps = consts + prog->nconsts * BLOCK;
+    for (size_t c = 0; c < prog->nconsts; c++)
+        for (size_t i = 0; i < BLOCK; i++) consts[c * BLOCK + i] = prog->consts[c];
+
+    for (size_t off = 0; off < n; off += BLOCK) {
+        size_t len = n - off < BLOCK ? n - off : BLOCK;
+        size_t sp = 0;
+
+        for (size_t pc = 0; pc < prog->len; pc++) {
+            const Instr *ip = &prog->code[pc];
+            switch ((OpCode)ip->op) {
+                case OP_PUSH: stack[sp++] = consts + ip->arg * BLOCK; break;
+                case OP_VAR:  stack[sp++] = cols[ip->arg] + off; break;
+                case OP_TEE:
+                    memcpy(temps + ip->arg * BLOCK, stack[sp - 1], len * sizeof(double));
+                    break;
+                case OP_LOAD: stack[sp++] = temps + ip->arg * BLOCK; break;
+                default: {
+                    // The last instruction writes straight into the output.
+                    double *dst = pc + 1 == prog->len ? out + off
+                                                      : prog->blocks + (sp - 2) * BLOCK;
+                    kern->op[ip->op](dst, stack[sp - 2], stack[sp - 1], len);
+                    stack[sp - 2] = dst;
+                    sp--;
+                    break;
+                }
+            }
+        }
+        if (stack[0] != out + off) memcpy(out + off, stack[0], len * sizeof(double));
     }
 }
 
 // ---------------- Parser ----------------
+// Recursive descent over the token stream, emitting RPN into `prog`. The
+// first error is kept in `err`; the current token is then forced to T_EOF
+// so every loop unwinds without further lexing or special cases.
 typedef struct {
     Lexer *lexer;
     Token current;
+    Program *prog;
+    CalError err;
+    int nesting;
 } Parser;
 
-double parse_expr(Parser *p); // forward declaration
+void parse_expr(Parser *p); // forward declaration
+
+void fail(Parser *p, CalStatus status, size_t pos) {
+    if (p->err.status == CAL_OK) p->err = (CalError){status, pos};
+    p->current.type = T_EOF;
+}
 
 void eat(Parser *p, TokenType type) {
     if (p->current.type == type)
         p->current = get_next_token(p->lexer);
-    else {
-        fprintf(stderr, "Unexpected token\n");
-        exit(1);
-    }
+    else
+        fail(p, CAL_ERR_UNEXPECTED, p->current.pos);
 }
 
-double parse_factor(Parser *p) {
+void parse_factor(Parser *p) {
     Token t = p->current;
-    double result = 0;
 
     if (t.type == T_NUMBER) {
-        result = t.value;
+        emit_const(p->prog, t.value);
         eat(p, T_NUMBER);
+    } else if (t.type == T_IDENT) {
+        if (emit_var(p->prog, p->lexer->text + t.pos, t.len, t.pos) != 0)
+            fail(p, CAL_ERR_VARS, t.pos);
+        else
+            eat(p, T_IDENT);
     } else if (t.type == T_LPAREN) {
+        if (++p->nesting > MAX_NESTING) {
+            fail(p, CAL_ERR_NESTING, t.pos);
+            return;
+        }
         eat(p, T_LPAREN);
-        result = parse_expr(p);
+        parse_expr(p);
         eat(p, T_RPAREN);
+        p->nesting--;
+    } else if (t.type == T_BAD_NUMBER) {
+        fail(p, CAL_ERR_NUMBER, t.pos);
     } else {
-        fprintf(stderr, "Syntax error: invalid factor\n");
-        exit(1);
+        fail(p, CAL_ERR_SYNTAX, t.pos);
     }
-    return result;
 }
 
-double parse_term(Parser *p) {
-    double result = parse_factor(p);
+void parse_term(Parser *p) {
+    parse_factor(p);
 
     while (p->current.type == T_STAR || p->current.type == T_SLASH) {
         Token op = p->current;
-        if (op.type == T_STAR) {
-            eat(p, T_STAR);
-            result *= parse_factor(p);
+        eat(p, op.type);
+        parse_factor(p);
+        emit(p->prog, op.type == T_STAR ? OP_MUL : OP_DIV, (uint32_t)op.pos);
+    }
+}
+
+void parse_expr(Parser *p) {
+    parse_term(p);
+
+    while (p->current.type == T_PLUS || p->current.type == T_MINUS) {
+        Token op = p->current;
+        eat(p, op.type);
+        parse_term(p);
+        emit(p->prog, op.type == T_PLUS ? OP_ADD : OP_SUB, (uint32_t)op.pos);
+    }
+}
+
+// Compiles text[0, len) into `prog` (previous contents are discarded). The
+// whole text must be one expression.
+CalError compile(Program *prog, const char *text, size_t len) {
+    Lexer lexer = {text, len, 0, {.type = T_EOF}};
+    Parser parser = {&lexer, get_next_token(&lexer), prog, {CAL_OK, 0}, 0};
+
+    program_reset(prog);
+    parse_expr(&parser);
+    if (parser.err.status == CAL_OK && parser.current.type != T_EOF)
+        fail(&parser, parser.current.type == T_BAD_NUMBER ? CAL_ERR_NUMBER : CAL_ERR_UNEXPECTED,
+             parser.current.pos);
+    return parser.err;
+}
+
+// ---------------- Optimizer ----------------
+// Rebuilds a compiled program as a DAG: every node is hash-consed, so equal
+// sub-expressions become one node (common-subexpression elimination), and
+// operators whose operands are both constants are evaluated once (constant
+// folding). A node used more than once is computed a single time, kept in
+// a temp with OP_TEE and re-read with OP_LOAD. Divisions by a constant zero
+// are left alone so the error still surfaces at run time.
+typedef struct {
+    uint32_t op;
+    uint32_t arg;       // const index, var index or source offset
+    uint32_t a, b;      // operand nodes
+    uint32_t uses;
+    uint32_t temp;      // temp index + 1 once emitted, 0 before
+    double value;       // for OP_PUSH
+} DagNode;
+
+typedef struct {
+    size_t before;      // instructions in the compiled program
+    size_t after;       // distinct nodes left after folding and sharing
+} OptStats;
+
+typedef struct {
+    DagNode *nodes;
+    size_t n;
+    uint32_t *table;    // open addressing, node index + 1, 0 = empty
+    size_t mask;
+} Dag;
+
+uint64_t node_hash(const DagNode *d) {
+    uint64_t key;
+    if (d->op == OP_PUSH)
+        memcpy(&key, &d->value, sizeof(key));
+    else if (d->op == OP_VAR)
+        key = d->arg;
+    else
+        key = (uint64_t)d->a << 32 | d->b;
+    uint64_t h = (d->op + 1) * 0x9E3779B97F4A7C15ULL ^ key;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    return h ^ (h >> 32);
+}
+
+// Source offsets of operators do not make two nodes different.
+int node_equal(const DagNode *x, const DagNode *y) {
+    if (x->op != y->op) return 0;
+    if (x->op == OP_PUSH) return memcmp(&x->value, &y->value, sizeof(double)) == 0;
+    if (x->op == OP_VAR) return x->arg == y->arg;
+    return x->a == y->a && x->b == y->b;
+}
+
+// Returns the index of the node equal to `d`, adding it if it is new.
+uint32_t dag_intern(Dag *g, DagNode d) {
+    size_t i = node_hash(&d) & g->mask;
+    while (g->table[i]) {
+        if (node_equal(&g->nodes[g->table[i] - 1], &d)) return g->table[i] - 1;
+        i = (i + 1) & g->mask;
+    }
+    g->nodes[g->n] = d;
+    g->table[i] = (uint32_t)++g->n;
+    return (uint32_t)(g->n - 1);
+}
+
+double fold(OpCode op, double x, double y) {
+    switch (op) {
+        case OP_ADD: return x + y;
+        case OP_SUB: return x - y;
+        case OP_MUL: return x * y;
+        default:     return x / y;
+    }
+}
+
+// Rewrites `prog` in place. A program that did not compile must not be
+// passed in. Fills *st if it is not NULL.
+void optimize(Program *prog, OptStats *st) {
+    size_t len = prog->len;
+    size_t tsize = 16;
+    if (len == 0) return;
+    while (tsize < 2 * len) tsize *= 2;
+
+    Dag g = {malloc(len * sizeof(DagNode)), 0, calloc(tsize, sizeof(uint32_t)), tsize - 1};
+    uint32_t *stack = malloc((prog->max_depth + 1) * sizeof(uint32_t));
+    if (!g.nodes || !g.table || !stack) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    // Build the DAG by running the program symbolically
+    size_t sp = 0;
+    for (size_t pc = 0; pc < len; pc++) {
+        Instr in = prog->code[pc];
+        DagNode d = {in.op, in.arg, 0, 0, 0, 0, 0};
+        if (in.op == OP_PUSH) {
+            d.value = prog->consts[in.arg];
+        } else if (in.op != OP_VAR) {
+            d.a = stack[sp - 2];
+            d.b = stack[sp - 1];
+            sp -= 2;
+            const DagNode *x = &g.nodes[d.a], *y = &g.nodes[d.b];
+            if (x->op == OP_PUSH && y->op == OP_PUSH && !(in.op == OP_DIV && y->value == 0)) {
+                d = (DagNode){OP_PUSH, 0, 0, 0, 0, 0, fold(in.op, x->value, y->value)};
+            }
+        }
+        stack[sp++] = dag_intern(&g, d);
+    }
+    uint32_t root = stack[0];
+
+    // Count uses among the nodes reachable from the root. Operands are
+    // always created before their users, so one backwards sweep is enough.
+    size_t live = 0;
+    g.nodes[root].uses = 1;
+    for (size_t i = g.n; i-- > 0;) {
+        DagNode *d = &g.nodes[i];
+        if (d->uses == 0) continue;
+        live++;
+        if (d->op != OP_PUSH && d->op != OP_VAR) {
+            g.nodes[d->a].uses++;
+            g.nodes[d->b].uses++;
+        }
+    }
+
+    // Emit post-order with an explicit stack (expressions can be very deep).
+    // Shared operator nodes are teed on first use and loaded afterwards;
+    // leaves are cheap enough to push again.
+    Instr *old_code = prog->code;
+    double *old_consts = prog->consts;
+    size_t nvars = prog->nvars;
+    prog->code = NULL;
+    prog->consts = NULL;
+    prog->cap = prog->cconsts = 0;
+    program_reset(prog);
+    prog->nvars = nvars;
+
+    uint32_t *state = calloc(g.n, sizeof(uint32_t));
+    uint32_t *work = malloc((g.n + 1) * sizeof(uint32_t));
+    if (!state || !work) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    size_t top = 0;
+    work[top++] = root;
+    while (top > 0) {
+        uint32_t id = work[top - 1];
+        DagNode *d = &g.nodes[id];
+        if (d->op == OP_PUSH) {
+            emit_const(prog, d->value);
+            top--;
+        } else if (d->op == OP_VAR) {
+            emit(prog, OP_VAR, d->arg);
+            top--;
+        } else if (d->temp) {
+            emit(prog, OP_LOAD, d->temp - 1);
+            top--;
+        } else if (state[id] == 0) {
+            state[id] = 1;
+            work[top++] = d->a;
+        } else if (state[id] == 1) {
+            state[id] = 2;
+            work[top++] = d->b;
         } else {
-            eat(p, T_SLASH);
-            double divisor = parse_factor(p);
-            if (divisor == 0) {
-                fprintf(stderr, "Division by zero\n");
-                exit(1);
+            emit(prog, (OpCode)d->op, d->arg);
+            if (d->uses > 1) {
+                d->temp = (uint32_t)++prog->ntemps;
+                emit(prog, OP_TEE, d->temp - 1);
             }
-            result /= divisor;
+            top--;
         }
     }
-    return result;
+
+    if (st) {
+        st->before = len;
+        st->after = live;
+    }
+    free(old_code);
+    free(old_consts);
+    free(state);
+    free(work);
+    free(stack);
+    free(g.nodes);
+    free(g.table);
 }
 
-double parse_expr(Parser *p) {
-    double result = parse_term(p);
+// ---------------- Output ----------------
+// Formats one result line into buf (RESULT_MAX bytes) and returns its
+// length. Integral values (the common case) are formatted by hand;
+// everything else goes through "%.0f" so the output is identical.
+size_t format_result(char *buf, double v) {
+    if (v > -1e15 && v < 1e15 && v == (double)(long long)v && !(v == 0 && signbit(v))) {
+        char tmp[24];
+        char *p = tmp + sizeof(tmp);
+        long long n = (long long)v;
+        unsigned long long u = n < 0 ? 0ULL - (unsigned long long)n : (unsigned long long)n;
 
-    while (p->current.type == T_PLUS || p->current.type == T_MINUS) {
-        Token op = p->current;
-        if (op.type == T_PLUS) {
-            eat(p, T_PLUS);
-            result += parse_term(p);
+        *--p = '\n';
+        do {
+            *--p = (char)('0' + u % 10);
+            u /= 10;
+        } while (u);
+        if (n < 0) *--p = '-';
+        size_t len = (size_t)(tmp + sizeof(tmp) - p);
+        memcpy(buf, p, len);
+        return len;
+    }
+    return (size_t)snprintf(buf, RESULT_MAX, "%.0f\n", v);
+}
+
+// Binary result files start with this header, followed by one BinRecord
+// per input line in native byte order. Failed and blank lines carry their
+// CalStatus (CAL_EMPTY for blank) and a NaN value.
+typedef struct {
+    char magic[4];          // "CALR"
+    uint32_t version;       // 1
+    uint32_t record_size;   // sizeof(BinRecord)
+    uint32_t reserved;
+} BinHeader;
+
+typedef struct {
+    double value;
+    uint32_t status;        // CalStatus
+    uint32_t pos;           // 1-based column of the error, 0 if none
+} BinRecord;
+
+// Growable byte buffer that results are formatted into, as text lines or
+// as BinRecords.
+typedef struct {
+    char *data;
+    size_t len, cap;
+    int binary;
+} OutBuf;
+
+void outbuf_record(OutBuf *b, double v, CalStatus status, size_t pos) {
+    BinRecord r = {v, (uint32_t)status, (uint32_t)pos};
+    b->data = grow(b->data, &b->cap, b->len + sizeof(r), 1);
+    memcpy(b->data + b->len, &r, sizeof(r));
+    b->len += sizeof(r);
+}
+
+void outbuf_result(OutBuf *b, double v) {
+    if (b->binary) {
+        outbuf_record(b, v, CAL_OK, 0);
+        return;
+    }
+    b->data = grow(b->data, &b->cap, b->len + RESULT_MAX, 1);
+    b->len += format_result(b->data + b->len, v);
+}
+
+void outbuf_putc(OutBuf *b, char c) {
+    b->data = grow(b->data, &b->cap, b->len + 1, 1);
+    b->data[b->len++] = c;
+}
+
+void outbuf_blank(OutBuf *b) {
+    if (b->binary)
+        outbuf_record(b, NAN, CAL_EMPTY, 0);
+    else
+        outbuf_putc(b, '\n');
+}
+
+// Failed lines become "ERR <code> <column> <message>" records so the
+// output stays one line per input line.
+void outbuf_error(OutBuf *b, CalError err) {
+    if (b->binary) {
+        outbuf_record(b, NAN, err.status, err.pos + 1);
+        return;
+    }
+    b->data = grow(b->data, &b->cap, b->len + 128, 1);
+    b->len += (size_t)snprintf(b->data + b->len, 128, "ERR %d %zu %s\n",
+                               (int)err.status, err.pos + 1, cal_strerror(err.status));
+}
+
+int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// ---------------- Sinks ----------------
+// Where results go, chosen at run time:
+//   "-" or "stdout"   text on standard output
+//   "append:PATH"     text appended to PATH, so many runs share one file
+//   "bin:PATH"        BinHeader + BinRecords, PATH is truncated
+//   "PATH"            text, PATH is truncated
+// Output is collected in SINK_BUF-sized batches; larger pieces (whole
+// batch chunks) are written straight through.
+typedef struct {
+    int fd;
+    int close_fd;
+    int binary;
+    int failed;             // a write() failed
+    OutBuf buf;
+    const char *name;
+} Sink;
+
+int sink_open(Sink *sk, const char *spec) {
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+    memset(sk, 0, sizeof(*sk));
+    sk->name = spec;
+    if (strcmp(spec, "-") == 0 || strcmp(spec, "stdout") == 0) {
+        sk->fd = STDOUT_FILENO;
+        sk->name = "stdout";
+        return 0;
+    }
+    if (strncmp(spec, "append:", 7) == 0) {
+        spec += 7;
+        flags = O_WRONLY | O_CREAT | O_APPEND;
+    } else if (strncmp(spec, "bin:", 4) == 0) {
+        spec += 4;
+        sk->binary = 1;
+    }
+    sk->name = spec;
+    sk->fd = open(spec, flags, 0666);
+    if (sk->fd < 0) return -1;
+    sk->close_fd = 1;
+    sk->buf.binary = sk->binary;
+    if (sk->binary) {
+        BinHeader h = {{'C', 'A', 'L', 'R'}, 1, sizeof(BinRecord), 0};
+        sk->failed = write_all(sk->fd, (const char *)&h, sizeof(h)) != 0;
+    }
+    return 0;
+}
+
+void sink_flush(Sink *sk) {
+    if (sk->buf.len > 0 && write_all(sk->fd, sk->buf.data, sk->buf.len) != 0) sk->failed = 1;
+    sk->buf.len = 0;
+}
+
+void sink_write(Sink *sk, const char *data, size_t len) {
+    if (sk->buf.len + len > SINK_BUF) sink_flush(sk);
+    if (len >= SINK_BUF) {
+        if (write_all(sk->fd, data, len) != 0) sk->failed = 1;
+        return;
+    }
+    sk->buf.data = grow(sk->buf.data, &sk->buf.cap, sk->buf.len + len, 1);
+    memcpy(sk->buf.data + sk->buf.len, data, len);
+    sk->buf.len += len;
+}
+
+// Adds one result, flushing whenever a full batch has built up.
+void sink_value(Sink *sk, double v) {
+    outbuf_result(&sk->buf, v);
+    if (sk->buf.len >= SINK_BUF) sink_flush(sk);
+}
+
+// Flushes and closes. Returns -1 if any write failed.
+int sink_close(Sink *sk) {
+    sink_flush(sk);
+    free(sk->buf.data);
+    if (sk->close_fd && close(sk->fd) != 0) sk->failed = 1;
+    return sk->failed ? -1 : 0;
+}
+
+// Run summaries go to stderr when the results themselves are on stdout.
+FILE *summary_stream(const Sink *sk) {
+    return sk->fd == STDOUT_FILENO ? stderr : stdout;
+}
+
+// Builds "<base>_Sandeep_241ADB010/<base>_Sandeep_Garg_241ADB010.txt" and
+// creates the folder. Returns 0 on success.
+int build_output_path(const char *infile, char *outpath, size_t size) {
+    char foldername[128];
+    char base[64];
+
+    snprintf(base, sizeof(base), "%s", infile);
+    base[strcspn(base, ".")] = '\0';
+
+    snprintf(foldername, sizeof(foldername), "%s_Sandeep_241ADB010", base);
+    mkdir(foldername, 0777);
+    return snprintf(outpath, size, "%s/%s_Sandeep_Garg_241ADB010.txt", foldername, base) < (int)size ? 0 : -1;
+}
+
+// Opens the sink named by `spec`, or the per-input default file when spec
+// is NULL. Prints the problem and returns -1 on failure.
+int open_output(Sink *sk, const char *spec, const char *infile, char *outpath, size_t size) {
+    if (!spec) {
+        if (build_output_path(infile, outpath, size) != 0) {
+            fprintf(stderr, "Output path too long for: %s\n", infile);
+            return -1;
+        }
+        spec = outpath;
+    }
+    if (sink_open(sk, spec) != 0) {
+        fprintf(stderr, "Cannot create output file: %s\n", sk->name);
+        return -1;
+    }
+    return 0;
+}
+
+// Closes the sink, reporting a failed write. Returns 0 on success.
+int close_output(Sink *sk) {
+    const char *name = sk->name;
+    if (sink_close(sk) != 0) {
+        fprintf(stderr, "Error writing output file: %s\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+// Adds one optimize() run to a running total.
+void opt_add(OptStats *total, const OptStats *part) {
+    total->before += part->before;
+    total->after += part->after;
+}
+
+void print_opt_stats(FILE *f, const OptStats *st) {
+    fprintf(f, "Optimizer removed %zu of %zu node(s)\n", st->before - st->after, st->before);
+}
+
+// Evaluates the expression in text[0, len), reusing prog's buffers. When
+// `opt` is not NULL the program is optimized first and the node counts are
+// added to *opt. Plain expressions have nothing to bind variables to.
+CalError evaluate(Program *prog, const char *text, size_t len, OptStats *opt, double *result) {
+    CalError err = compile(prog, text, len);
+    if (err.status != CAL_OK) return err;
+    if (prog->nvars > 0) return (CalError){CAL_ERR_UNKNOWN_VAR, prog->var_pos[0]};
+    if (opt) {
+        OptStats st;
+        optimize(prog, &st);
+        opt_add(opt, &st);
+    }
+    return run_program(prog, NULL, result);
+}
+
+// ---------------- Input ----------------
+// The whole input file as one read-only byte range. Regular files are
+// memory-mapped, so lines are lexed in place with no copies and no length
+// limit; anything that cannot be mapped (pipes, empty files) is read into
+// the heap instead.
+typedef struct {
+    const char *data;
+    size_t size;
+    int mapped;
+    char *heap;     // owned copy when the file could not be mapped
+} InputFile;
+
+int input_open(InputFile *in, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    memset(in, 0, sizeof(*in));
+    in->data = "";
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            in->data = map;
+            in->size = (size_t)st.st_size;
+            in->mapped = 1;
+            close(fd);
+            return 0;
+        }
+    }
+
+    char *buf = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    do {
+        buf = grow(buf, &cap, in->size + OUTBUF, 1);
+        n = read(fd, buf + in->size, cap - in->size);
+        if (n > 0) in->size += (size_t)n;
+    } while (n > 0);
+    close(fd);
+    if (n < 0) {
+        free(buf);
+        return -1;
+    }
+    if (buf) in->data = in->heap = buf;
+    return 0;
+}
+
+void input_close(InputFile *in) {
+    if (in->mapped) munmap((void *)in->data, in->size);
+    free(in->heap);
+    memset(in, 0, sizeof(*in));
+}
+
+// Returns the length of the line starting at p (without its newline).
+size_t line_length(const char *p, const char *end) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    return (size_t)((nl ? nl : end) - p);
+}
+
+int is_blank(const char *p, size_t len) {
+    for (size_t i = 0; i < len; i++)
+        if (!isspace((unsigned char)p[i])) return 0;
+    return 1;
+}
+
+// ---------------- Batch mode ----------------
+typedef struct {
+    long lines;
+    long errors;
+    long first_error;   // 1-based line of the first error, 0 if none
+    OptStats opt;
+} BatchStats;
+
+// Adds the stats of the next piece of input to a running total.
+void stats_add(BatchStats *total, const BatchStats *part) {
+    if (total->first_error == 0 && part->first_error != 0)
+        total->first_error = total->lines + part->first_error;
+    total->lines += part->lines;
+    total->errors += part->errors;
+    opt_add(&total->opt, &part->opt);
+}
+
+// Evaluates every line of data[0, size) and appends one result line per
+// input line to `out`. Blank lines produce blank output lines so that line
+// numbers stay aligned; lines that fail produce ERR records. Each line is
+// run through optimize() first if `opt` is set.
+BatchStats eval_lines(Program *prog, const char *data, size_t size, int opt, OutBuf *out) {
+    const char *p = data;
+    const char *end = data + size;
+    BatchStats st = {0, 0, 0, {0, 0}};
+
+    while (p < end) {
+        size_t len = line_length(p, end);
+        st.lines++;
+        if (is_blank(p, len)) {
+            outbuf_blank(out);
         } else {
-            eat(p, T_MINUS);
-            result -= parse_term(p);
+            double v;
+            CalError err = evaluate(prog, p, len, opt ? &st.opt : NULL, &v);
+            if (err.status == CAL_OK) {
+                outbuf_result(out, v);
+            } else {
+                outbuf_error(out, err);
+                if (st.errors++ == 0) st.first_error = st.lines;
+            }
         }
+        p += len + 1;
     }
-    return result;
+    return st;
 }
 
-// ---------------- Main ----------------
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <inputfile>\n", argv[0]);
-        return 1;
+// The input is cut into CHUNK-sized work units, each moved forward to just
+// past a newline so no line is split. Chunk i is [chunk_start(i),
+// chunk_start(i + 1)).
+size_t chunk_start(const char *data, size_t size, size_t i) {
+    if (i == 0) return 0;
+    if (i > (size - 1) / CHUNK) return size;
+    const char *nl = memchr(data + i * CHUNK - 1, '\n', size - (i * CHUNK - 1));
+    return nl ? (size_t)(nl - data) + 1 : size;
+}
+
+// Shared state of a parallel batch run. Workers claim chunks in order and
+// format results into one of `nslots` output buffers; the main thread
+// writes finished buffers in chunk order. A worker never runs more than
+// nslots chunks ahead of the writer, which bounds memory use.
+typedef struct {
+    const char *data;
+    size_t size;
+    size_t nchunks;
+    size_t next;        // next chunk to claim
+    size_t written;     // chunks already written out
+    size_t nslots;
+    int optimize;
+    OutBuf *slots;      // slot i % nslots holds chunk i
+    BatchStats *stats;  // per slot
+    int *done;          // slot holds a finished chunk
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} BatchPool;
+
+void *batch_worker(void *arg) {
+    BatchPool *bp = arg;
+    Program prog;
+
+    program_init(&prog);
+    for (;;) {
+        pthread_mutex_lock(&bp->lock);
+        while (bp->next < bp->nchunks && bp->next >= bp->written + bp->nslots)
+            pthread_cond_wait(&bp->cond, &bp->lock);
+        if (bp->next == bp->nchunks) {
+            pthread_mutex_unlock(&bp->lock);
+            break;
+        }
+        size_t c = bp->next++;
+        pthread_mutex_unlock(&bp->lock);
+
+        size_t slot = c % bp->nslots;
+        size_t start = chunk_start(bp->data, bp->size, c);
+        size_t end = chunk_start(bp->data, bp->size, c + 1);
+        bp->slots[slot].len = 0;
+        BatchStats st = eval_lines(&prog, bp->data + start, end - start, bp->optimize, &bp->slots[slot]);
+
+        pthread_mutex_lock(&bp->lock);
+        bp->stats[slot] = st;
+        bp->done[slot] = 1;
+        pthread_cond_broadcast(&bp->cond);
+        pthread_mutex_unlock(&bp->lock);
+    }
+    program_free(&prog);
+    return NULL;
+}
+
+// Evaluates every line of data[0, size) on `nthreads` worker threads and
+// writes the results to `out` in input order.
+BatchStats run_batch(const char *data, size_t size, Sink *out, int nthreads, int opt) {
+    size_t nchunks = size ? (size - 1) / CHUNK + 1 : 0;
+    BatchStats total = {0, 0, 0, {0, 0}};
+
+    if (nthreads <= 1) {
+        Program prog;
+        OutBuf buf = {NULL, 0, 0, out->binary};
+
+        program_init(&prog);
+        for (size_t c = 0; c < nchunks; c++) {
+            size_t start = chunk_start(data, size, c);
+            buf.len = 0;
+            BatchStats st = eval_lines(&prog, data + start, chunk_start(data, size, c + 1) - start, opt, &buf);
+            stats_add(&total, &st);
+            sink_write(out, buf.data, buf.len);
+        }
+        free(buf.data);
+        program_free(&prog);
+        return total;
+    }
+
+    BatchPool bp = {data, size, nchunks, 0, 0, 2 * (size_t)nthreads, opt,
+                    NULL, NULL, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+    pthread_t *threads = malloc((size_t)nthreads * sizeof(pthread_t));
+    bp.slots = calloc(bp.nslots, sizeof(OutBuf));
+    bp.stats = calloc(bp.nslots, sizeof(BatchStats));
+    bp.done = calloc(bp.nslots, sizeof(int));
+    if (!threads || !bp.slots || !bp.stats || !bp.done) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < bp.nslots; i++) bp.slots[i].binary = out->binary;
+
+    int started = 0;
+    while (started < nthreads && pthread_create(&threads[started], NULL, batch_worker, &bp) == 0)
+        started++;
+    if (started == 0) {
+        fprintf(stderr, "Cannot start worker threads\n");
+        exit(1);
     }
 
-    const char *infile = argv[1];
+    for (size_t c = 0; c < nchunks; c++) {
+        size_t slot = c % bp.nslots;
+
+        pthread_mutex_lock(&bp.lock);
+        while (!bp.done[slot]) pthread_cond_wait(&bp.cond, &bp.lock);
+        pthread_mutex_unlock(&bp.lock);
+
+        sink_write(out, bp.slots[slot].data, bp.slots[slot].len);
+        stats_add(&total, &bp.stats[slot]);
+
+        pthread_mutex_lock(&bp.lock);
+        bp.done[slot] = 0;
+        bp.written++;
+        pthread_cond_broadcast(&bp.cond);
+        pthread_mutex_unlock(&bp.lock);
+    }
+
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    for (size_t i = 0; i < bp.nslots; i++) free(bp.slots[i].data);
+    free(bp.slots);
+    free(bp.stats);
+    free(bp.done);
+    free(threads);
+    pthread_mutex_destroy(&bp.lock);
+    pthread_cond_destroy(&bp.cond);
+    return total;
+}
+
+// ---------------- Column mode ----------------
+// A column file has a header line naming the columns, then one row of
+// numbers per line; fields are separated by whitespace or commas.
+typedef struct {
+    char names[MAX_VARS][MAX_VAR_NAME];
+    double *data[MAX_VARS];
+    size_t ncols, nrows, cap;
+} Columns;
+
+void columns_free(Columns *c) {
+    for (size_t i = 0; i < c->ncols; i++) free(c->data[i]);
+    memset(c, 0, sizeof(*c));
+}
+
+int is_field_sep(char c) {
+    return c == ',' || isspace((unsigned char)c);
+}
+
+// Reads a column file. Returns 0 on success, prints the problem otherwise.
+int load_columns(FILE *in, Columns *c) {
+    char *line = NULL;
+    size_t linecap = 0;
+    long lineno = 1;
+    int rc = -1;
+
+    memset(c, 0, sizeof(*c));
+    if (getline(&line, &linecap, in) == -1) {
+        fprintf(stderr, "Empty column file\n");
+        goto done;
+    }
+    for (char *p = line; *p;) {
+        while (*p && is_field_sep(*p)) p++;
+        if (!*p) break;
+        char *start = p;
+        while (*p && !is_field_sep(*p)) p++;
+        if (c->ncols == MAX_VARS || (size_t)(p - start) >= MAX_VAR_NAME) {
+            fprintf(stderr, "Too many or too long column names\n");
+            goto done;
+        }
+        memcpy(c->names[c->ncols], start, (size_t)(p - start));
+        c->names[c->ncols][p - start] = '\0';
+        c->ncols++;
+    }
+
+    while (getline(&line, &linecap, in) != -1) {
+        lineno++;
+        char *p = line;
+        while (*p && is_field_sep(*p)) p++;
+        if (!*p) continue;
+
+        if (c->nrows == c->cap) {
+            size_t cap = c->cap;
+            for (size_t i = 0; i < c->ncols; i++) {
+                cap = c->cap;
+                c->data[i] = grow(c->data[i], &cap, c->nrows + 1, sizeof(double));
+            }
+            c->cap = cap;
+        }
+        for (size_t i = 0; i < c->ncols; i++) {
+            double v;
+            while (*p && is_field_sep(*p)) p++;
+            int neg = *p == '-';
+            if (*p == '-' || *p == '+') p++;
+            size_t n = scan_number(p, strlen(p), &v);
+            if (n == 0 || (p[n] && !is_field_sep(p[n]))) {
+                fprintf(stderr, "Line %ld: expected %zu numbers\n", lineno, c->ncols);
+                goto done;
+            }
+            c->data[i][c->nrows] = neg ? -v : v;
+            p += n;
+        }
+        c->nrows++;
+    }
+    rc = 0;
+done:
+    free(line);
+    return rc;
+}
+
+// Evaluates `expr` over every row of a column file.
+int main_columns(const char *expr, const char *infile, const char *outspec) {
+    char outpath[256];
+    Sink sink;
+    Columns cols;
+    Program prog;
+    const double *bound[MAX_VARS];
+
     FILE *f = fopen(infile, "r");
     if (!f) {
         fprintf(stderr, "Cannot open input file: %s\n", infile);
         return 1;
     }
+    setvbuf(f, NULL, _IOFBF, OUTBUF);
+    int rc = load_columns(f, &cols);
+    fclose(f);
+    if (rc != 0) {
+        columns_free(&cols);
+        return 1;
+    }
 
-    char buffer[MAXBUF];
-    if (!fgets(buffer, sizeof(buffer), f)) {
-        fprintf(stderr, "Empty input file\n");
-        fclose(f);
+    program_init(&prog);
+    CalError err = compile(&prog, expr, strlen(expr));
+    if (err.status != CAL_OK) {
+        fprintf(stderr, "%s at column %zu\n", cal_strerror(err.status), err.pos + 1);
+        program_free(&prog);
+        columns_free(&cols);
         return 1;
     }
-    fclose(f);
+    OptStats ost;
+    optimize(&prog, &ost);
+    for (size_t i = 0; i < prog.nvars; i++) {
+        size_t j = 0;
+        while (j < cols.ncols && strcmp(cols.names[j], prog.vars[i]) != 0) j++;
+        if (j == cols.ncols) {
+            fprintf(stderr, "Unknown variable: %s\n", prog.vars[i]);
+            program_free(&prog);
+            columns_free(&cols);
+            return 1;
+        }
+        bound[i] = cols.data[j];
+    }
 
-    // Lexer and parser
-    Lexer lexer = {buffer, 0};
-    Parser parser = {&lexer, get_next_token(&lexer)};
-    double result = parse_expr(&parser);
+    double *result = malloc((cols.nrows ? cols.nrows : 1) * sizeof(double));
+    if (!result) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    run_columns(&prog, bound, cols.nrows, result);
+    program_free(&prog);
 
-    // Build output directory and file
-    char foldername[128];
+    if (open_output(&sink, outspec, infile, outpath, sizeof(outpath)) != 0) {
+        rc = 1;
+        goto out;
+    }
+    for (size_t i = 0; i < cols.nrows; i++) sink_value(&sink, result[i]);
+    FILE *summary = summary_stream(&sink);
+    const char *name = sink.name;
+    if (close_output(&sink) != 0) {
+        rc = 1;
+        goto out;
+    }
+    fprintf(summary, "%zu row(s) evaluated, output written to: %s\n", cols.nrows, name);
+    print_opt_stats(summary, &ost);
+out:
+    free(result);
+    columns_free(&cols);
+    return rc;
+}
+
+// ---------------- Server mode ----------------
+// A long-running evaluator: requests are lines of text, each answered by
+// one line in the batch output format. Compiled programs are cached by
+// expression text, so a repeated formula skips lexing and parsing.
+typedef struct {
+    uint64_t hash;
+    char *key;              // expression text, NULL if the entry is empty
+    size_t klen;
+    Program prog;
+    CalError err;           // compile result
+} CacheEntry;
+
+typedef struct {
+    CacheEntry *entries;
+    size_t mask;            // entries - 1, a power of two minus one
+    uint64_t hits, misses;
+    OptStats opt;           // over every program compiled into the cache
+} ExprCache;
+
+uint64_t hash_text(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ULL;   // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void cache_init(ExprCache *c, size_t size) {
+    c->entries = calloc(size, sizeof(CacheEntry));
+    if (!c->entries) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    c->mask = size - 1;
+    c->hits = c->misses = 0;
+    c->opt = (OptStats){0, 0};
+}
+
+void cache_free(ExprCache *c) {
+    for (size_t i = 0; i <= c->mask; i++) {
+        free(c->entries[i].key);
+        program_free(&c->entries[i].prog);
+    }
+    free(c->entries);
+}
+
+// Returns the entry holding text[0, len) compiled. The cache is direct
+// mapped: a miss recompiles into the entry's slot, replacing whatever was
+// there and reusing its buffers.
+CacheEntry *cache_lookup(ExprCache *c, const char *text, size_t len) {
+    uint64_t h = hash_text(text, len);
+    CacheEntry *e = &c->entries[h & c->mask];
+
+    if (e->key && e->hash == h && e->klen == len && memcmp(e->key, text, len) == 0) {
+        c->hits++;
+        return e;
+    }
+    c->misses++;
+    free(e->key);
+    e->key = malloc(len ? len : 1);
+    if (!e->key) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    memcpy(e->key, text, len);
+    e->klen = len;
+    e->hash = h;
+    e->err = compile(&e->prog, text, len);
+    if (e->err.status == CAL_OK && e->prog.nvars > 0)
+        e->err = (CalError){CAL_ERR_UNKNOWN_VAR, e->prog.var_pos[0]};
+    if (e->err.status == CAL_OK) {
+        // Cached programs run many times, so optimizing them pays off
+        OptStats st;
+        optimize(&e->prog, &st);
+        opt_add(&c->opt, &st);
+    }
+    return e;
+}
+
+// Latency histogram with 8 buckets per power of two (about 9% resolution).
+#define LAT_SUB 8
+#define LAT_BUCKETS (64 * LAT_SUB)
+
+typedef struct {
+    uint64_t buckets[LAT_BUCKETS];
+    uint64_t count, max;
+} LatencyHist;
+
+size_t lat_bucket(uint64_t ns) {
+    if (ns < LAT_SUB) return (size_t)ns;
+    int log2 = 63 - __builtin_clzll(ns);
+    return (size_t)log2 * LAT_SUB + (size_t)((ns >> (log2 - 3)) & (LAT_SUB - 1));
+}
+
+// Smallest value that falls in bucket b.
+uint64_t lat_bucket_floor(size_t b) {
+    if (b < LAT_SUB) return b;
+    size_t log2 = b / LAT_SUB;
+    return (1ULL << log2) | ((uint64_t)(b % LAT_SUB) << (log2 - 3));
+}
+
+void lat_record(LatencyHist *h, uint64_t ns) {
+    h->buckets[lat_bucket(ns)]++;
+    h->count++;
+    if (ns > h->max) h->max = ns;
+}
+
+uint64_t lat_percentile(const LatencyHist *h, double pct) {
+    uint64_t rank = (uint64_t)ceil(pct / 100.0 * (double)h->count);
+    uint64_t seen = 0;
+    if (rank == 0) rank = 1;
+    for (size_t b = 0; b < LAT_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) return lat_bucket_floor(b);
+    }
+    return h->max;
+}
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+typedef struct {
+    ExprCache cache;
+    LatencyHist lat;
+    uint64_t errors;
+} Server;
+
+int format_stats(const Server *srv, char *buf, size_t size) {
+    const LatencyHist *h = &srv->lat;
+    uint64_t lookups = srv->cache.hits + srv->cache.misses;
+    return snprintf(buf, size,
+                    "STATS requests=%llu errors=%llu cache_hit=%.1f%% nodes_removed=%zu "
+                    "p50=%lluns p90=%lluns p99=%lluns p99.9=%lluns max=%lluns\n",
+                    (unsigned long long)h->count, (unsigned long long)srv->errors,
+                    lookups ? 100.0 * (double)srv->cache.hits / (double)lookups : 0.0,
+                    srv->cache.opt.before - srv->cache.opt.after,
+                    (unsigned long long)lat_percentile(h, 50), (unsigned long long)lat_percentile(h, 90),
+                    (unsigned long long)lat_percentile(h, 99), (unsigned long long)lat_percentile(h, 99.9),
+                    (unsigned long long)h->max);
+}
+
+// Answers every complete line in data[0, len) into `out` and returns the
+// number of bytes consumed. The line ":stats" is answered with a STATS
+// record instead of being evaluated.
+size_t serve_lines(Server *srv, const char *data, size_t len, OutBuf *out) {
+    const char *p = data;
+    const char *end = data + len;
+    const char *nl;
+
+    while (p < end && (nl = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        size_t n = (size_t)(nl - p);
+        if (n > 0 && p[n - 1] == '\r') n--;
+
+        if (n == 6 && memcmp(p, ":stats", 6) == 0) {
+            char buf[256];
+            int k = format_stats(srv, buf, sizeof(buf));
+            out->data = grow(out->data, &out->cap, out->len + (size_t)k, 1);
+            memcpy(out->data + out->len, buf, (size_t)k);
+            out->len += (size_t)k;
+        } else if (is_blank(p, n)) {
+            outbuf_putc(out, '\n');
+        } else {
+            uint64_t t0 = now_ns();
+            CacheEntry *e = cache_lookup(&srv->cache, p, n);
+            CalError err = e->err;
+            double v = 0;
+            if (err.status == CAL_OK) err = run_program(&e->prog, NULL, &v);
+            if (err.status == CAL_OK) {
+                outbuf_result(out, v);
+            } else {
+                outbuf_error(out, err);
+                srv->errors++;
+            }
+            lat_record(&srv->lat, now_ns() - t0);
+        }
+        p = nl + 1;
+    }
+    return (size_t)(p - data);
+}
+
+// One connection (or stdin/stdout): bytes read but not yet a full line
+// stay in `in` until the rest arrives. Answers wait in `out` from offset
+// `sent` until the peer takes them.
+typedef struct {
+    int in_fd, out_fd;
+    OutBuf in, out;
+    size_t sent;
+    int eof;           // the peer will send nothing more
+} Client;
+
+// Reads what is available and answers every complete line into cl->out.
+// Returns -1 when the peer is gone; a last line without a newline still
+// gets an answer.
+int client_read(Server *srv, Client *cl) {
+    cl->in.data = grow(cl->in.data, &cl->in.cap, cl->in.len + 65536, 1);
+    ssize_t n = read(cl->in_fd, cl->in.data + cl->in.len, cl->in.cap - cl->in.len);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    if (n <= 0) {
+        if (cl->in.len > 0) {
+            outbuf_putc(&cl->in, '\n');
+            serve_lines(srv, cl->in.data, cl->in.len, &cl->out);
+            cl->in.len = 0;
+        }
+        return -1;
+    }
+    cl->in.len += (size_t)n;
+
+    size_t used = serve_lines(srv, cl->in.data, cl->in.len, &cl->out);
+    memmove(cl->in.data, cl->in.data + used, cl->in.len - used);
+    cl->in.len -= used;
+    return 0;
+}
+
+// Serves stdin/stdout: reads, then answers with one blocking write.
+// Returns -1 when the input is exhausted.
+int client_service(Server *srv, Client *cl) {
+    int rc = client_read(srv, cl);
+    int wrc = write_all(cl->out_fd, cl->out.data, cl->out.len);
+    cl->out.len = 0;
+    return rc != 0 ? -1 : wrc;
+}
+
+// Sends as much pending output as a non-blocking socket takes. Returns -1
+// if the peer is gone.
+int client_flush(Client *cl) {
+    while (cl->sent < cl->out.len) {
+        ssize_t n = write(cl->out_fd, cl->out.data + cl->sent, cl->out.len - cl->sent);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Keep the buffer from creeping forward while the peer is slow
+            if (cl->sent > cl->out.len / 2) {
+                memmove(cl->out.data, cl->out.data + cl->sent, cl->out.len - cl->sent);
+                cl->out.len -= cl->sent;
+                cl->sent = 0;
+            }
+            return 0;
+        }
+        if (n < 0) return -1;
+        cl->sent += (size_t)n;
+    }
+    cl->out.len = cl->sent = 0;
+    return 0;
+}
+
+void client_free(Client *cl) {
+    free(cl->in.data);
+    free(cl->out.data);
+}
+
+static volatile sig_atomic_t stop_serving = 0;
+
+void on_stop_signal(int sig) {
+    (void)sig;
+    stop_serving = 1;
+}
+
+// Serves stdin/stdout, or every client of a Unix-domain socket at
+// `sockpath`, until EOF on stdin or SIGINT/SIGTERM. Cache and latency
+// statistics go to stderr on exit.
+int main_serve(const char *sockpath) {
+    Server srv;
+    struct sigaction sa;
+    int rc = 0;
+
+    memset(&srv, 0, sizeof(srv));
+    cache_init(&srv.cache, CACHE_SIZE);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    if (!sockpath) {
+        Client cl = {0, 1, {0}, {0}, 0, 0};
+        while (!stop_serving && client_service(&srv, &cl) == 0) {}
+        client_free(&cl);
+    } else {
+        struct sockaddr_un addr;
+        struct pollfd fds[MAX_CLIENTS + 1];
+        Client clients[MAX_CLIENTS + 1];
+        nfds_t nfds = 1;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(sockpath) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", sockpath);
+            cache_free(&srv.cache);
+            return 1;
+        }
+        strcpy(addr.sun_path, sockpath);
+        unlink(sockpath);
+
+        int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 64) != 0) {
+            fprintf(stderr, "Cannot listen on %s: %s\n", sockpath, strerror(errno));
+            if (lfd >= 0) close(lfd);
+            cache_free(&srv.cache);
+            return 1;
+        }
+        fprintf(stderr, "Listening on %s\n", sockpath);
+        fds[0] = (struct pollfd){lfd, POLLIN, 0};
+
+        while (!stop_serving) {
+            // With the table full, leave new connections in the backlog;
+            // polling for them would return at once, over and over
+            fds[0].events = nfds <= MAX_CLIENTS ? POLLIN : 0;
+            if (poll(fds, nfds, -1) < 0) {
+                if (errno == EINTR) continue;
+                rc = 1;
+                break;
+            }
+            if (fds[0].revents & POLLIN) {
+                int cfd = accept(lfd, NULL, NULL);
+                // Clients never block the server: a slow reader only
+                // delays its own replies
+                if (cfd >= 0 && fcntl(cfd, F_SETFL, O_NONBLOCK) != 0) {
+                    close(cfd);
+                } else if (cfd >= 0) {
+                    fds[nfds] = (struct pollfd){cfd, POLLIN, 0};
+                    clients[nfds] = (Client){cfd, cfd, {0}, {0}, 0, 0};
+                    nfds++;
+                }
+            }
+            for (nfds_t i = 1; i < nfds; i++) {
+                Client *cl = &clients[i];
+                if (fds[i].revents == 0) continue;
+                int drop = 0;
+                if ((fds[i].events & POLLIN) && (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                    if (client_read(&srv, cl) != 0) cl->eof = 1;
+                    // A line this long is not an expression; stop buffering it
+                    drop = cl->in.len > CLIENT_LINE_MAX;
+                }
+                if (!drop) drop = client_flush(cl) != 0 || (cl->eof && cl->out.len == 0);
+                // Stop reading from a client that does not take its answers
+                fds[i].events = (short)((!cl->eof && cl->out.len - cl->sent <= CLIENT_OUT_MAX ? POLLIN : 0) |
+                                        (cl->out.len > cl->sent ? POLLOUT : 0));
+                if (drop) {
+                    close(fds[i].fd);
+                    client_free(&clients[i]);
+                    fds[i] = fds[nfds - 1];
+                    clients[i] = clients[nfds - 1];
+                    nfds--;
+                    i--;
+                }
+            }
+        }
+        for (nfds_t i = 1; i < nfds; i++) {
+            close(fds[i].fd);
+            client_free(&clients[i]);
+        }
+        close(lfd);
+        unlink(sockpath);
+    }
+
+    char buf[256];
+    format_stats(&srv, buf, sizeof(buf));
+    fputs(buf, stderr);
+    cache_free(&srv.cache);
+    return rc;
+}
+
+// ---------------- Main ----------------
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-f] [-o sink] <inputfile>\n", prog);
+    fprintf(stderr, "       %s -b [-j threads] [-f] [-o sink] <inputfile> [outputfile]   (evaluate every line)\n", prog);
+    fprintf(stderr, "       %s -e <expr> [-o sink] <columnfile> [outputfile]   (evaluate over columns)\n", prog);
+    fprintf(stderr, "       %s -s [socketpath]   (serve lines from stdin or a Unix socket)\n", prog);
+    fprintf(stderr, "  -j 0 uses one thread per online CPU\n");
+    fprintf(stderr, "  -f folds constants and shares repeated sub-expressions before evaluating\n");
+    fprintf(stderr, "  sink: - (stdout), append:PATH, bin:PATH or PATH; default is a folder per input\n");
+}
+
+int main_batch(const char *infile, const char *outspec, int nthreads, int opt) {
     char outpath[256];
-    char base[64];
+    InputFile in;
+    Sink sink;
 
-    strncpy(base, infile, sizeof(base));
-    base[strcspn(base, ".")] = '\0';
+    if (input_open(&in, infile) != 0) {
+        fprintf(stderr, "Cannot open input file: %s\n", infile);
+        return 1;
+    }
+    if (open_output(&sink, outspec, infile, outpath, sizeof(outpath)) != 0) {
+        input_close(&in);
+        return 1;
+    }
 
-    snprintf(foldername, sizeof(foldername), "%s_Sandeep_241ADB010", base);
-    mkdir(foldername, 0777);
-    snprintf(outpath, sizeof(outpath), "%s/%s_Sandeep_Garg_241ADB010.txt", foldername, base);
+    BatchStats st = run_batch(in.data, in.size, &sink, nthreads, opt);
+    input_close(&in);
+    FILE *summary = summary_stream(&sink);
+    const char *name = sink.name;
+    if (close_output(&sink) != 0) return 1;
+
+    fprintf(summary, "%ld expression(s) evaluated, output written to: %s\n", st.lines, name);
+    if (opt) print_opt_stats(summary, &st.opt);
+    if (st.errors > 0)
+        fprintf(stderr, "%ld line(s) failed, first at line %ld\n", st.errors, st.first_error);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int batch = 0;
+    int serve = 0;
+    int nthreads = 1;
+    int opt_flag = 0;
+    const char *expr = NULL;
+    const char *outspec = NULL;
+    int opt;
 
-    FILE *outf = fopen(outpath, "w");
-    if (!outf) {
-        fprintf(stderr, "Cannot create output file: %s\n", outpath);
+    while ((opt = getopt(argc, argv, "bj:e:so:f")) != -1) {
+        switch (opt) {
+            case 'b': batch = 1; break;
+            case 'j':
+                batch = 1;
+                nthreads = atoi(optarg);
+                if (nthreads <= 0) nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+                if (nthreads <= 0) nthreads = 1;
+                break;
+            case 'e': expr = optarg; break;
+            case 's': serve = 1; break;
+            case 'o': outspec = optarg; break;
+            case 'f': opt_flag = 1; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    int nargs = argc - optind;
+    if (serve) {
+        if (nargs > 1) {
+            usage(argv[0]);
+            return 1;
+        }
+        return main_serve(nargs == 1 ? argv[optind] : NULL);
+    }
+    if (nargs < 1 || nargs > 2 || (!batch && !expr && nargs != 1) || (outspec && nargs == 2)) {
+        usage(argv[0]);
         return 1;
     }
-    fprintf(outf, "%.0f\n", result);
-    fclose(outf);
+    if (nargs == 2) outspec = argv[optind + 1];
+
+    if (expr) return main_columns(expr, argv[optind], outspec);
+    if (batch) return main_batch(argv[optind], outspec, nthreads, opt_flag);
+
+    const char *infile = argv[optind];
+    InputFile in;
+    if (input_open(&in, infile) != 0) {
+        fprintf(stderr, "Cannot open input file: %s\n", infile);
+        return 1;
+    }
+    if (in.size == 0) {
+        fprintf(stderr, "Empty input file\n");
+        input_close(&in);
+        return 1;
+    }
+
+    // Only the first line is evaluated, however long it is
+    Program prog;
+    program_init(&prog);
+    double result;
+    OptStats ost = {0, 0};
+    CalError err = evaluate(&prog, in.data, line_length(in.data, in.data + in.size),
+                            opt_flag ? &ost : NULL, &result);
+    program_free(&prog);
+    input_close(&in);
+    if (err.status != CAL_OK) {
+        fprintf(stderr, "%s at column %zu\n", cal_strerror(err.status), err.pos + 1);
+        return 1;
+    }
+
+    // Build output directory and file unless a sink was given
+    char outpath[256];
+    Sink sink;
+    if (open_output(&sink, outspec, infile, outpath, sizeof(outpath)) != 0) return 1;
+    sink_value(&sink, result);
+    FILE *summary = summary_stream(&sink);
+    const char *name = sink.name;
+    if (close_output(&sink) != 0) return 1;
 
-    printf("Output written to: %s\n", outpath);
+    fprintf(summary, "Output written to: %s\n", name);
+    if (opt_flag) print_opt_stats(summary, &ost);
     return 0;
 }
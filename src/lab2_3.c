@@ -1,4 +1,13 @@
+#define _POSIX_C_SOURCE 200809L // For sysconf
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
 
 /*
     Task:
@@ -11,34 +20,534 @@
       - Otherwise, print all prime numbers up to n
 */
 
+// Largest n prime_sieve() accepts
+#define SIEVE_MAX (UINT64_C(1) << 62)
+
+// Receives primes in increasing order, one block at a time
+typedef void (*PrimeSink)(const uint64_t *primes, size_t count, void *ctx);
+
+int is_prime(int n);
+// Deterministic primality test for any 64-bit n: trial division by the
+// primes up to 53, then Miller-Rabin with a base set proven for 64 bits
+int is_prime_u64(uint64_t n);
+// result[i] = is_prime_u64(n[i]) for i < count. Faster per number than
+// single calls, since several tests are run interleaved.
+void is_prime_batch(const uint64_t *n, size_t count, unsigned char *result);
+// Finds the primes up to n with a segmented sieve and stores how many there
+// are in *count. Unless `sink` is NULL they are also passed to it in order;
+// calls come from the sieving threads but never overlap. `threads` 0 means
+// one per CPU. Returns 0 if n is above SIEVE_MAX or out of memory.
+int prime_sieve(uint64_t n, unsigned threads, PrimeSink sink, void *ctx, uint64_t *count);
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [N [list|count [THREADS]]]\n"
+            "       %s test NUMBER...\n"
+            "Without arguments asks for N. list prints the primes up to N, one\n"
+            "per line; count only prints how many there are. THREADS defaults\n"
+            "to one per CPU. test says whether each 64-bit NUMBER is prime.\n",
+            prog,
+            prog);
+}
+
+// Writes primes as decimal text through a large buffer
+typedef struct {
+    FILE *out;
+    size_t len;
+    char buf[1 << 16];
+} TextSink;
+
+static void text_flush(TextSink *t) {
+    fwrite(t->buf, 1, t->len, t->out);
+    t->len = 0;
+}
+
+static void text_write(const uint64_t *primes, size_t count, void *ctx) {
+    TextSink *t = ctx;
+    for (size_t i = 0; i < count; i++) {
+        // 20 digits and a newline at most
+        if (t->len + 21 > sizeof(t->buf)) text_flush(t);
+        char digits[20];
+        int nd = 0;
+        uint64_t v = primes[i];
+        do {
+            digits[nd++] = (char)('0' + v % 10);
+            v /= 10;
+        } while (v != 0);
+        while (nd > 0) t->buf[t->len++] = digits[--nd];
+        t->buf[t->len++] = '\n';
+    }
+}
+
+static int parse_u64(const char *s, uint64_t max, uint64_t *v) {
+    char *end;
+    if (*s < '0' || *s > '9') return 0;
+    errno = 0;
+    unsigned long long x = strtoull(s, &end, 10);
+    if (*end != '\0' || errno == ERANGE || x > max) return 0;
+    *v = x;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    uint64_t n, count;
+    int list = 1;
+    unsigned threads = 0;
+
+    if (argc > 2 && strcmp(argv[1], "test") == 0) {
+        size_t count = (size_t)argc - 2;
+        uint64_t *numbers = malloc(count * sizeof(*numbers));
+        unsigned char *prime = malloc(count);
+        if (numbers == NULL || prime == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (!parse_u64(argv[i + 2], UINT64_MAX, &numbers[i])) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        is_prime_batch(numbers, count, prime);
+        for (size_t i = 0; i < count; i++)
+            printf("%llu is %s\n", (unsigned long long)numbers[i], prime[i] ? "prime" : "not prime");
+        free(numbers);
+        free(prime);
+        return EXIT_SUCCESS;
+    }
+
+    if (argc > 1) {
+        uint64_t t = 0;
+        if (argc > 4 || !parse_u64(argv[1], SIEVE_MAX, &n) ||
+            (argc >= 3 && strcmp(argv[2], "list") != 0 && strcmp(argv[2], "count") != 0) ||
+            (argc == 4 && (!parse_u64(argv[3], 1024, &t) || t == 0))) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        list = argc < 3 || strcmp(argv[2], "list") == 0;
+        threads = (unsigned)t;
+    } else {
+        long long input;
+        printf("Enter an integer n (>= 2): ");
+        if (scanf("%lld", &input) != 1 || input < 2 || (unsigned long long)input > SIEVE_MAX) {
+            printf("Incorrect! Kindly enter any number above 2.\n");
+            return EXIT_FAILURE;
+        }
+        n = (uint64_t)input;
+        printf("The prime numbers up to %llu are: \n", (unsigned long long)n);
+    }
+
+    if (!list) {
+        if (!prime_sieve(n, threads, NULL, NULL, &count)) {
+            fprintf(stderr, "Out of memory.\n");
+            return EXIT_FAILURE;
+        }
+        printf("There are %llu primes up to %llu.\n",
+               (unsigned long long)count, (unsigned long long)n);
+        return EXIT_SUCCESS;
+    }
+
+    static TextSink text;
+    fflush(stdout);
+    text.out = stdout;
+    int ok = prime_sieve(n, threads, text_write, &text, &count);
+    text_flush(&text);
+    if (!ok) {
+        fprintf(stderr, "Out of memory.\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
 int is_prime(int n) {
-    // TODO: check if n is prime using loop up to sqrt(n)
-    if (n<2){
-        return 0;
-    for(int i=2; i<=sqrt(n); i++){
-        if(n%i==0){
-            return 0;
+    return n >= 2 && is_prime_u64((uint64_t)n);
+}
+
+// --- SEGMENTED SIEVE ---
+// Only odd numbers are stored: bit i of a segment starting at `low` stands
+// for low + 2i + 1. Multiples of 3, 5, 7, 11 and 13 are cleared by copying
+// a precomputed pattern into each fresh segment, so crossing off starts at
+// 17. Segments fit in L1, and threads take chunks of consecutive segments.
+
+// Bytes per segment, sized for a 32 KiB L1 data cache
+#define SEG_BYTES (32 * 1024)
+#define SEG_BITS ((uint64_t)SEG_BYTES * 8)
+// Integers one segment covers
+#define SEG_SPAN (SEG_BITS * 2)
+// Segments a thread sieves per chunk
+#define CHUNK_SEGS 16
+#define CHUNK_SPAN (SEG_SPAN * CHUNK_SEGS)
+
+// Pattern of the odd numbers coprime to 3 * 5 * 7 * 11 * 13. It repeats
+// every 15015 bits, so every 15015 bytes at byte granularity; the extra
+// SEG_BYTES let one memcpy fill a segment from any offset.
+#define PRESIEVE_BYTES (3 * 5 * 7 * 11 * 13)
+#define PRESIEVE_LAST 13
+static uint8_t presieve[PRESIEVE_BYTES + SEG_BYTES];
+static pthread_once_t presieve_once = PTHREAD_ONCE_INIT;
+
+static void presieve_init(void) {
+    for (size_t i = 0; i < sizeof(presieve); i++) {
+        uint8_t byte = 0;
+        for (int b = 0; b < 8; b++) {
+            uint64_t v = 2 * (8 * (uint64_t)i + b) + 1;
+            if (v % 3 && v % 5 && v % 7 && v % 11 && v % 13) byte |= (uint8_t)(1u << b);
         }
+        presieve[i] = byte;
     }
-    return 1; // placeholder
 }
 
-int main(void) {
-    int n;
+typedef struct {
+    uint64_t n;
+    const uint32_t *primes;     // odd primes from 17 up to sqrt(n)
+    size_t nprimes;
+    uint64_t chunks;
+    PrimeSink sink;
+    void *ctx;
 
-    printf("Enter an integer n (>= 2): ");
-    scanf("%d", &n);
-    if (n<2){
-        printf("Incorrect! Kindly enter any number above 2.");
+    pthread_mutex_t lock;       // guards the fields below
+    pthread_cond_t turn;
+    uint64_t next_chunk;        // next chunk to hand out
+    uint64_t next_emit;         // next chunk whose primes go to the sink
+    uint64_t count;
+    int failed;
+} Sieve;
+
+// Clears the composites in the segment starting at `low`. next[i] is where
+// primes[i] strikes next, as a bit index relative to this segment.
+static void sieve_segment(const Sieve *sv, uint8_t *seg, uint64_t low, uint64_t *next) {
+    memcpy(seg, presieve + (low / 16) % PRESIEVE_BYTES, SEG_BYTES);
+    if (low == 0) {
+        // The pattern keeps 1 but clears the pre-sieved primes themselves
+        seg[0] = (uint8_t)((seg[0] & ~1u) | 0x6e);  // 3, 5, 7, 11, 13
     }
-    else{
-        printf("The prime numbers up to %d are: \n");
-        for(int i=2;i<=n;i++){
-            if(is_prime(i)){
-                printf("%d",i);
+
+    for (size_t i = 0; i < sv->nprimes; i++) {
+        uint64_t p = sv->primes[i];
+        uint64_t j = next[i];
+        for (; j < SEG_BITS; j += p) seg[j >> 3] &= (uint8_t)~(1u << (j & 7));
+        next[i] = j - SEG_BITS;
+    }
+}
+
+static void *sieve_worker(void *arg) {
+    Sieve *sv = arg;
+    uint64_t *seg = aligned_alloc(64, SEG_BYTES);
+    uint64_t *next = malloc((sv->nprimes + 1) * sizeof(*next));
+    uint64_t *found = NULL;
+    size_t cap = 0;
+    int ok = seg != NULL && next != NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&sv->lock);
+        uint64_t c = sv->next_chunk++;
+        pthread_mutex_unlock(&sv->lock);
+        if (c >= sv->chunks) break;
+
+        uint64_t low = c * CHUNK_SPAN;
+        uint64_t chunk_count = 0;
+        size_t nfound = 0;
+
+        if (ok) {
+            // First odd multiple of each prime in this chunk, from p * p on
+            for (size_t i = 0; i < sv->nprimes; i++) {
+                uint64_t p = sv->primes[i];
+                uint64_t m = p * p;
+                if (m < low) {
+                    m = (low + p - 1) / p * p;
+                    if (m % 2 == 0) m += p;
+                }
+                next[i] = (m - low) / 2;
+            }
+            if (c == 0 && sv->n >= 2) {
+                chunk_count++;
+                if (sv->sink != NULL) {
+                    if (cap == 0 && (found = malloc((cap = 1024) * sizeof(*found))) == NULL) ok = 0;
+                    else found[nfound++] = 2;
+                }
             }
-          printf("\n");
         }
+
+        for (int s = 0; ok && s < CHUNK_SEGS; s++) {
+            uint64_t seg_low = low + (uint64_t)s * SEG_SPAN;
+            if (seg_low > sv->n) break;
+            sieve_segment(sv, (uint8_t *)seg, seg_low, next);
+
+            uint64_t nbits = (sv->n - seg_low + 1) / 2;
+            if (nbits > SEG_BITS) nbits = SEG_BITS;
+            size_t words = (size_t)(nbits + 63) / 64;
+            if (nbits % 64 != 0) seg[words - 1] &= (UINT64_C(1) << (nbits % 64)) - 1;
+
+            if (sv->sink == NULL) {
+                for (size_t k = 0; k < words; k++) chunk_count += (uint64_t)__builtin_popcountll(seg[k]);
+                continue;
+            }
+            for (size_t k = 0; k < words; k++) {
+                uint64_t w = seg[k];
+                size_t bits = (size_t)__builtin_popcountll(w);
+                if (nfound + bits > cap) {
+                    size_t grown = cap * 2 + SEG_BITS / 8;
+                    uint64_t *p = realloc(found, grown * sizeof(*found));
+                    if (p == NULL) {
+                        ok = 0;
+                        break;
+                    }
+                    found = p;
+                    cap = grown;
+                }
+                uint64_t base = seg_low + 128 * (uint64_t)k + 1;
+                for (; w != 0; w &= w - 1) found[nfound++] = base + 2 * (uint64_t)__builtin_ctzll(w);
+                chunk_count += bits;
+            }
+        }
+
+        // Chunks reach the sink in order; counting needs no turn taking
+        pthread_mutex_lock(&sv->lock);
+        if (sv->sink != NULL) {
+            while (sv->next_emit != c) pthread_cond_wait(&sv->turn, &sv->lock);
+            if (ok && !sv->failed) sv->sink(found, nfound, sv->ctx);
+            sv->next_emit++;
+            pthread_cond_broadcast(&sv->turn);
+        }
+        sv->count += chunk_count;
+        if (!ok) sv->failed = 1;
+        pthread_mutex_unlock(&sv->lock);
+    }
+
+    free(found);
+    free(next);
+    free(seg);
+    return NULL;
+}
+
+// Odd primes from 17 up to `limit` by a plain sieve; *nprimes gets how many
+static uint32_t *sieving_primes(uint64_t limit, size_t *nprimes) {
+    size_t size = (size_t)limit / 2 + 1;    // byte i is 2i + 1
+    uint8_t *composite = calloc(size, 1);
+    size_t estimate = limit < 64 ? 16 : (size_t)(1.3 * (double)limit / log((double)limit)) + 16;
+    uint32_t *primes = malloc(estimate * sizeof(*primes));
+    if (composite == NULL || primes == NULL) {
+        free(composite);
+        free(primes);
+        return NULL;
+    }
+
+    size_t count = 0;
+    for (size_t i = 1; i < size; i++) {
+        if (composite[i]) continue;
+        uint64_t p = 2 * (uint64_t)i + 1;
+        if (p > PRESIEVE_LAST) primes[count++] = (uint32_t)p;
+        for (uint64_t j = p * p / 2; j < size; j += p) composite[j] = 1;
+    }
+    free(composite);
+    *nprimes = count;
+    return primes;
+}
+
+int prime_sieve(uint64_t n, unsigned threads, PrimeSink sink, void *ctx, uint64_t *count) {
+    *count = 0;
+    if (n > SIEVE_MAX) return 0;
+    if (n < 2) return 1;
+    pthread_once(&presieve_once, presieve_init);
+
+    uint64_t root = (uint64_t)sqrt((double)n);
+    while (root * root > n) root--;
+    while ((root + 1) * (root + 1) <= n) root++;
+
+    Sieve sv = {0};
+    sv.n = n;
+    sv.primes = sieving_primes(root, &sv.nprimes);
+    if (sv.primes == NULL) return 0;
+    sv.chunks = n / CHUNK_SPAN + 1;
+    sv.sink = sink;
+    sv.ctx = ctx;
+    pthread_mutex_init(&sv.lock, NULL);
+    pthread_cond_init(&sv.turn, NULL);
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned)cpus : 1;
+    }
+    if (threads > sv.chunks) threads = (unsigned)sv.chunks;
+
+    // The calling thread is one of the workers
+    pthread_t *tids = malloc(threads * sizeof(*tids));
+    unsigned started = 0;
+    if (tids != NULL)
+        while (started + 1 < threads && pthread_create(&tids[started], NULL, sieve_worker, &sv) == 0)
+            started++;
+    sieve_worker(&sv);
+    for (unsigned i = 0; i < started; i++) pthread_join(tids[i], NULL);
+    free(tids);
+
+    pthread_cond_destroy(&sv.turn);
+    pthread_mutex_destroy(&sv.lock);
+    free((void *)sv.primes);
+    *count = sv.count;
+    return !sv.failed;
+}
+
+
+// --- PRIMALITY TEST ---
+// Miller-Rabin in Montgomery form, R = 2^64. Bases 2, 7 and 61 decide every
+// n below 2^32; the seven bases of Jim Sinclair's set decide all 64-bit n.
+// Base 2 runs first on its own since it rejects nearly every composite, and
+// it needs no conversion into Montgomery form: multiplying by 2 is a
+// doubling. The remaining bases only run for (almost always) primes, and
+// run together so their multiplications overlap.
+
+__extension__ typedef unsigned __int128 u128;
+
+// Primes below 64 as a bit set
+#define SMALL_PRIMES UINT64_C(0x28208a20a08a28ac)
+// Odd n below this with no factor up to 53 are prime (59 * 59)
+#define TRIAL_LIMIT 3481
+// Candidates is_prime_batch() tests at once
+#define BATCH_LANES 8
+
+static const uint64_t bases32[] = {7, 61};
+static const uint64_t bases64[] = {325, 9375, 28178, 450775, 9780504, 1795265022};
+
+typedef struct {
+    uint64_t n;         // odd modulus
+    uint64_t inv;       // n^-1 mod R
+    uint64_t one;       // R mod n
+} Mont;
+
+static inline void mont_init(Mont *m, uint64_t n) {
+    // Newton's iteration doubles the correct low bits; n * n = 1 mod 8
+    uint64_t inv = n;
+    for (int i = 0; i < 5; i++) inv *= 2 - n * inv;
+    m->n = n;
+    m->inv = inv;
+    m->one = (0 - n) % n;
+}
+
+// a * b / R mod n, for a, b < n
+static inline uint64_t mont_mul(const Mont *m, uint64_t a, uint64_t b) {
+    u128 t = (u128)a * b;
+    uint64_t hi = (uint64_t)(t >> 64);
+    uint64_t q = (uint64_t)t * m->inv;
+    uint64_t qn = (uint64_t)(((u128)q * m->n) >> 64);
+    // Masks rather than branches: the comparisons are unpredictable
+    return hi - qn + (m->n & (0 - (uint64_t)(hi < qn)));
+}
+
+// 2x mod n, for x < n
+static inline uint64_t mont_double(const Mont *m, uint64_t x) {
+    uint64_t rest = m->n - x;
+    return x - rest + (m->n & (0 - (uint64_t)(x < rest)));
+}
+
+// 2x mod n if `bit` is set, otherwise x
+static inline uint64_t mont_double_if(const Mont *m, uint64_t x, uint64_t bit) {
+    uint64_t mask = 0 - (bit & 1);
+    return (mont_double(m, x) & mask) | (x & ~mask);
+}
+
+// Whether a^d (in Montgomery form) passes the strong probable prime test,
+// where n - 1 = d * 2^s
+static inline int mr_finish(const Mont *m, uint64_t x, int s) {
+    uint64_t minus_one = m->n - m->one;
+    if (x == m->one || x == minus_one) return 1;
+    for (int i = 1; i < s; i++) {
+        x = mont_mul(m, x, x);
+        if (x == minus_one) return 1;
+        if (x == m->one) return 0;
     }
     return 0;
 }
+
+// Tests n against every base after 2
+static int mr_other_bases(const Mont *m, uint64_t d, int s) {
+    const uint64_t *bases = m->n >> 32 ? bases64 : bases32;
+    int k = m->n >> 32 ? (int)(sizeof(bases64) / sizeof(*bases64)) : 2;
+    uint64_t r2 = (uint64_t)((u128)m->one * m->one % m->n);
+    uint64_t a[sizeof(bases64) / sizeof(*bases64)], x[sizeof(bases64) / sizeof(*bases64)];
+
+    // Every base is below n, since n >= TRIAL_LIMIT and n >= 2^32 for bases64
+    for (int j = 0; j < k; j++) x[j] = a[j] = mont_mul(m, bases[j], r2);
+    for (int i = 62 - __builtin_clzll(d); i >= 0; i--) {
+        for (int j = 0; j < k; j++) x[j] = mont_mul(m, x[j], x[j]);
+        if ((d >> i) & 1)
+            for (int j = 0; j < k; j++) x[j] = mont_mul(m, x[j], a[j]);
+    }
+    for (int j = 0; j < k; j++)
+        if (!mr_finish(m, x[j], s)) return 0;
+    return 1;
+}
+
+// 1 or 0 if trial division decides n, otherwise -1
+static inline int trial_division(uint64_t n) {
+    if (n < 64) return (int)(SMALL_PRIMES >> n) & 1;
+    // Constant divisors compile to a multiply and compare each
+    if (n % 2 == 0 || n % 3 == 0 || n % 5 == 0 || n % 7 == 0 || n % 11 == 0 ||
+        n % 13 == 0 || n % 17 == 0 || n % 19 == 0 || n % 23 == 0 || n % 29 == 0 ||
+        n % 31 == 0 || n % 37 == 0 || n % 41 == 0 || n % 43 == 0 || n % 47 == 0 ||
+        n % 53 == 0)
+        return 0;
+    return n < TRIAL_LIMIT ? 1 : -1;
+}
+
+int is_prime_u64(uint64_t n) {
+    int known = trial_division(n);
+    if (known >= 0) return known;
+
+    Mont m;
+    mont_init(&m, n);
+    int s = __builtin_ctzll(n - 1);
+    uint64_t d = (n - 1) >> s;
+
+    // 2^d, starting from the top bit of d
+    uint64_t x = mont_double(&m, m.one);
+    for (int i = 62 - __builtin_clzll(d); i >= 0; i--) {
+        x = mont_mul(&m, x, x);
+        x = mont_double_if(&m, x, d >> i);
+    }
+    return mr_finish(&m, x, s) && mr_other_bases(&m, d, s);
+}
+
+// Runs the base-2 round for up to BATCH_LANES candidates in lockstep, then
+// the other bases for those that pass
+static void batch_lanes(const uint64_t *n, const size_t *idx, int lanes, unsigned char *result) {
+    Mont m[BATCH_LANES];
+    uint64_t d[BATCH_LANES], x[BATCH_LANES];
+    int s[BATCH_LANES], top = 0;
+
+    for (int j = 0; j < lanes; j++) {
+        mont_init(&m[j], n[idx[j]]);
+        s[j] = __builtin_ctzll(m[j].n - 1);
+        d[j] = (m[j].n - 1) >> s[j];
+        x[j] = m[j].one;
+        int bits = 64 - __builtin_clzll(d[j]);
+        if (bits > top) top = bits;
+    }
+    for (int i = top - 1; i >= 0; i--) {
+        for (int j = 0; j < lanes; j++) {
+            x[j] = mont_mul(&m[j], x[j], x[j]);
+            x[j] = mont_double_if(&m[j], x[j], d[j] >> i);
+        }
+    }
+    for (int j = 0; j < lanes; j++)
+        result[idx[j]] = (unsigned char)(mr_finish(&m[j], x[j], s[j]) &&
+                                         mr_other_bases(&m[j], d[j], s[j]));
+}
+
+void is_prime_batch(const uint64_t *n, size_t count, unsigned char *result) {
+    size_t idx[BATCH_LANES];
+    int lanes = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int known = trial_division(n[i]);
+        if (known >= 0) {
+            result[i] = (unsigned char)known;
+            continue;
+        }
+        idx[lanes++] = i;
+        if (lanes == BATCH_LANES) {
+            batch_lanes(n, idx, lanes, result);
+            lanes = 0;
+        }
+    }
+    if (lanes > 0) batch_lanes(n, idx, lanes, result);
+}
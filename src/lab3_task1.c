@@ -21,60 +21,328 @@
  *   avg = array_avg(arr, 5); // 3.0
  */
 
+#define _POSIX_C_SOURCE 200809L // For sysconf
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ARRAY_X86 1
+#endif
+
+// Everything array_stats() computes. For an empty array min is INT_MAX,
+// max is INT_MIN and sum and mean are 0.
+typedef struct {
+    int min;
+    int max;
+    long long sum;
+    double mean;
+} ArrayStats;
+
+// Most threads a reduction uses, including the caller
+#define REDUCE_MAX_THREADS 64
+// Fewest elements worth giving a thread; smaller inputs stay on one
+#define REDUCE_MIN_CHUNK (1 << 18)
+
+// Associative reduction over an int array. `fold` adds arr[0, n) into the
+// partial result at `acc`; `combine` merges the partial at `other` into
+// `acc`. Partials are `acc_size` bytes and start as a copy of `identity`.
+typedef struct {
+    void (*fold)(const int *arr, size_t n, void *acc);
+    void (*combine)(void *acc, const void *other);
+    size_t acc_size;
+    const void *identity;
+} ReduceOp;
+
+// Min, max and sum (no mean) as one reduction; array_stats() uses it
+extern const ReduceOp REDUCE_STATS;
 
 // Function prototypes
 int array_min(int arr[], int size);
 int array_max(int arr[], int size);
-int array_sum(int arr[], int size);
+long long array_sum(int arr[], int size);
 float array_avg(int arr[], int size);
+// Min, max, 64-bit sum and mean in a single pass over the array, using the
+// widest SIMD kernel the CPU supports and, for large arrays, all cores
+ArrayStats array_stats(const int arr[], size_t size);
+// Reduces arr[0, size) with `op` into `result` (op->acc_size bytes). Large
+// arrays are split into cache-line-aligned chunks, one per thread of a
+// shared pool; calls from several threads take turns.
+void array_reduce(const int arr[], size_t size, const ReduceOp *op, void *result);
 
 int main(void) {
     int arr[] = {10, 20, 5, 30, 15};
     int size = 5;
+    ArrayStats st = array_stats(arr, (size_t)size);
 
-    printf("Min: %d\n", array_min(arr, size));
-    printf("Max: %d\n", array_max(arr, size));
-    printf("Sum: %d\n", array_sum(arr, size));
-    printf("Avg: %.2f\n", array_avg(arr, size));
+    printf("Min: %d\n", st.min);
+    printf("Max: %d\n", st.max);
+    printf("Sum: %lld\n", st.sum);
+    printf("Avg: %.2f\n", st.mean);
 
     return 0;
 }
 
 // Implement functions below
 int array_min(int arr[], int size) {
-    // TODO: return smallest element
-    int my_min = INT_MAX; //set to max infinity
-    for (int i=0;i<size;i++) {
-        if (my_min > arr[i]) {
-            my_min = arr[i];
-        }
-    }
-    return my_min; // placeholder
+    // Smallest element
+    return size > 0 ? array_stats(arr, (size_t)size).min : INT_MAX;
 }
 
 int array_max(int arr[], int size) {
-    // TODO: return largest element
-    int my_max = INT_MIN;
-    for (int i=0;i<size;i++){
-        if (my_max < arr[i]){
-            my_max = arr[i];
-        }
+    // Largest element
+    return size > 0 ? array_stats(arr, (size_t)size).max : INT_MIN;
+}
+
+long long array_sum(int arr[], int size) {
+    // Sum of elements; 64-bit, so it cannot overflow for any int array
+    return size > 0 ? array_stats(arr, (size_t)size).sum : 0;
+}
+
+float array_avg(int arr[], int size) {
+    // Average as float
+    return size > 0 ? (float)array_stats(arr, (size_t)size).mean : 0.0f;
+}
+
+// --- FUSED STATISTICS KERNELS ---
+// Each kernel folds arr[0, n) into *st (min, max and sum only). The SIMD
+// kernels keep per-lane minima, maxima and 64-bit sums, widening every
+// int as it is added, and hand the tail to the scalar kernel.
+
+typedef void (*StatsKernel)(const int *arr, size_t n, ArrayStats *st);
+
+static void stats_scalar(const int *arr, size_t n, ArrayStats *st) {
+    for (size_t i = 0; i < n; i++) {
+        if (arr[i] < st->min) st->min = arr[i];
+        if (arr[i] > st->max) st->max = arr[i];
+        st->sum += arr[i];
     }
-    return my_max; // placeholder
 }
 
-int array_sum(int arr[], int size) {
-    // TODO: return sum of elements
-    int my_sum = 0;
-    for (int i=0;i<size;i++){
-        my_sum += arr[i];
+#ifdef ARRAY_X86
+__attribute__((target("sse4.1")))
+static void stats_sse41(const int *arr, size_t n, ArrayStats *st) {
+    __m128i vmin = _mm_set1_epi32(st->min), vmax = _mm_set1_epi32(st->max);
+    __m128i sum0 = _mm_setzero_si128(), sum1 = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(arr + i));
+        vmin = _mm_min_epi32(vmin, v);
+        vmax = _mm_max_epi32(vmax, v);
+        sum0 = _mm_add_epi64(sum0, _mm_cvtepi32_epi64(v));
+        sum1 = _mm_add_epi64(sum1, _mm_cvtepi32_epi64(_mm_unpackhi_epi64(v, v)));
     }
-    return my_sum; // placeholder
+
+    int mins[4], maxs[4];
+    long long sums[2];
+    _mm_storeu_si128((__m128i *)mins, vmin);
+    _mm_storeu_si128((__m128i *)maxs, vmax);
+    _mm_storeu_si128((__m128i *)sums, _mm_add_epi64(sum0, sum1));
+    for (int k = 0; k < 4; k++) {
+        if (mins[k] < st->min) st->min = mins[k];
+        if (maxs[k] > st->max) st->max = maxs[k];
+    }
+    st->sum += sums[0] + sums[1];
+    stats_scalar(arr + i, n - i, st);
 }
 
-float array_avg(int arr[], int size) {
-    // TODO: return average as float
-    return (float)array_sum(arr,size) / size; // placeholder 
-}
\ No newline at end of file
+__attribute__((target("avx2")))
+static void stats_avx2(const int *arr, size_t n, ArrayStats *st) {
+    __m256i vmin = _mm256_set1_epi32(st->min), vmax = _mm256_set1_epi32(st->max);
+    __m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(arr + i));
+        vmin = _mm256_min_epi32(vmin, v);
+        vmax = _mm256_max_epi32(vmax, v);
+        sum0 = _mm256_add_epi64(sum0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        sum1 = _mm256_add_epi64(sum1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+
+    int mins[8], maxs[8];
+    long long sums[4];
+    _mm256_storeu_si256((__m256i *)mins, vmin);
+    _mm256_storeu_si256((__m256i *)maxs, vmax);
+    _mm256_storeu_si256((__m256i *)sums, _mm256_add_epi64(sum0, sum1));
+    for (int k = 0; k < 8; k++) {
+        if (mins[k] < st->min) st->min = mins[k];
+        if (maxs[k] > st->max) st->max = maxs[k];
+    }
+    st->sum += sums[0] + sums[1] + sums[2] + sums[3];
+    stats_scalar(arr + i, n - i, st);
+}
+
+__attribute__((target("avx512f")))
+static void stats_avx512(const int *arr, size_t n, ArrayStats *st) {
+    __m512i vmin = _mm512_set1_epi32(st->min), vmax = _mm512_set1_epi32(st->max);
+    __m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512();
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_loadu_si512(arr + i);
+        vmin = _mm512_min_epi32(vmin, v);
+        vmax = _mm512_max_epi32(vmax, v);
+        sum0 = _mm512_add_epi64(sum0, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v)));
+        sum1 = _mm512_add_epi64(sum1, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v, 1)));
+    }
+
+    int lo = _mm512_reduce_min_epi32(vmin), hi = _mm512_reduce_max_epi32(vmax);
+    if (lo < st->min) st->min = lo;
+    if (hi > st->max) st->max = hi;
+    st->sum += _mm512_reduce_add_epi64(_mm512_add_epi64(sum0, sum1));
+    stats_scalar(arr + i, n - i, st);
+}
+#endif
+
+// Picks the widest kernel the CPU supports
+static StatsKernel stats_kernel(void) {
+#ifdef ARRAY_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return stats_avx512;
+    if (__builtin_cpu_supports("avx2")) return stats_avx2;
+    if (__builtin_cpu_supports("sse4.1")) return stats_sse41;
+#endif
+    return stats_scalar;
+}
+
+// Chosen once; pool threads may fold chunks at the same time
+static StatsKernel kernel = stats_scalar;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void pick_kernel(void) {
+    kernel = stats_kernel();
+}
+
+static void stats_fold(const int *arr, size_t n, void *acc) {
+    pthread_once(&kernel_once, pick_kernel);
+    kernel(arr, n, acc);
+}
+
+static void stats_combine(void *acc, const void *other) {
+    ArrayStats *a = acc;
+    const ArrayStats *b = other;
+
+    if (b->min < a->min) a->min = b->min;
+    if (b->max > a->max) a->max = b->max;
+    a->sum += b->sum;
+}
+
+static const ArrayStats stats_identity = {INT_MAX, INT_MIN, 0, 0.0};
+const ReduceOp REDUCE_STATS = {stats_fold, stats_combine, sizeof(ArrayStats), &stats_identity};
+
+ArrayStats array_stats(const int arr[], size_t size) {
+    ArrayStats st;
+
+    array_reduce(arr, size, &REDUCE_STATS, &st);
+    if (size > 0) st.mean = (double)st.sum / (double)size;
+    return st;
+}
+
+// --- PARALLEL REDUCTION ---
+
+// Worker threads started on the first large reduction and kept for later
+// ones. The caller works on chunk 0 itself; worker k takes chunk k + 1.
+static struct {
+    pthread_mutex_t run;          // held for the whole of one reduction
+    pthread_mutex_t lock;         // guards the fields below
+    pthread_cond_t start, done;
+    int workers;
+    unsigned long job;            // bumped for every reduction
+    int pending;                  // workers not finished with `job`
+    // Current reduction
+    const int *arr;
+    size_t bounds[REDUCE_MAX_THREADS + 1];
+    int parts;
+    const ReduceOp *op;
+    char *partials;               // one `stride`-byte slot per chunk
+    size_t stride;                // whole cache lines, so slots never share one
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+          PTHREAD_COND_INITIALIZER, 0, 0, 0, NULL, {0}, 0, NULL, NULL, 0};
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void reduce_chunk(int k) {
+    pool.op->fold(pool.arr + pool.bounds[k], pool.bounds[k + 1] - pool.bounds[k],
+                  pool.partials + (size_t)k * pool.stride);
+}
+
+static void *reduce_worker(void *arg) {
+    int k = (int)(size_t)arg + 1;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.job == seen) pthread_cond_wait(&pool.start, &pool.lock);
+        seen = pool.job;
+        if (k >= pool.parts) continue;
+        pthread_mutex_unlock(&pool.lock);
+        reduce_chunk(k);
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.pending == 0) pthread_cond_signal(&pool.done);
+    }
+    return NULL;
+}
+
+static void pool_start(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int want = cpus > REDUCE_MAX_THREADS ? REDUCE_MAX_THREADS : (int)cpus;
+
+    // The caller is one of the threads
+    for (int i = 0; i < want - 1; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, reduce_worker, (void *)(size_t)i) != 0) break;
+        pthread_detach(tid);
+        pool.workers++;
+    }
+}
+
+void array_reduce(const int arr[], size_t size, const ReduceOp *op, void *result) {
+    memcpy(result, op->identity, op->acc_size);
+    if (size / REDUCE_MIN_CHUNK < 2) {
+        op->fold(arr, size, result);
+        return;
+    }
+
+    pthread_once(&pool_once, pool_start);
+    int parts = pool.workers + 1;
+    if ((size_t)parts > size / REDUCE_MIN_CHUNK) parts = (int)(size / REDUCE_MIN_CHUNK);
+    size_t stride = (op->acc_size + 63) / 64 * 64;
+    char *partials = parts > 1 ? aligned_alloc(64, (size_t)parts * stride) : NULL;
+    if (partials == NULL) {
+        op->fold(arr, size, result);
+        return;
+    }
+    for (int k = 0; k < parts; k++) memcpy(partials + (size_t)k * stride, op->identity, op->acc_size);
+
+    pthread_mutex_lock(&pool.run);
+    pthread_mutex_lock(&pool.lock);
+    pool.arr = arr;
+    pool.op = op;
+    pool.partials = partials;
+    pool.stride = stride;
+    pool.parts = parts;
+    // Chunk edges fall on 16-int (64-byte) boundaries
+    for (int k = 0; k < parts; k++) pool.bounds[k] = size * (size_t)k / (size_t)parts / 16 * 16;
+    pool.bounds[parts] = size;
+    pool.pending = parts - 1;
+    pool.job++;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+
+    reduce_chunk(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.pending > 0) pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.run);
+
+    for (int k = 0; k < parts; k++) op->combine(result, partials + (size_t)k * stride);
+    free(partials);
+}
@@ -20,15 +20,29 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STR_X86 1
+#endif
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define STR_SWAR 1
+#endif
 
 // Function prototypes
 int my_strlen(const char *str);
 void my_strcpy(char *dest, const char *src);
+// Copies at most size - 1 characters of src plus a terminator into dest
+// (nothing if size is 0). Returns the number of characters copied.
+size_t my_strlcpy(char *dest, const char *src, size_t size);
 
 int main(void) {
     // TODO: Test your functions here
     char test[] = "Programming in C";
     char copy[100];
+    char small[12];
 
     int len = my_strlen(test);
     printf("Length: %d\n", len);
@@ -36,25 +50,244 @@ int main(void) {
     my_strcpy(copy, test);
     printf("Copy: %s\n", copy);
 
+    size_t copied = my_strlcpy(small, test, sizeof(small));
+    printf("Bounded copy: %s (%zu characters)\n", small, copied);
+
     return 0;
 }
 
-// Implement functions below
-int my_strlen(const char *str) {
-    // TODO: count characters until '\0'
-    int len = 0;
-    while(str[len] != '\0'){
-        len++;
+// --- STRING KERNELS ---
+// Every kernel scans the source in aligned blocks of W bytes. An aligned
+// block never straddles a page, so reading a whole block that holds at
+// least one byte of the string cannot fault, even past its end; the bytes
+// of the first block that lie before the string are masked off. zmask()
+// returns a mask of the zero bytes of one block with ZBITS bits per byte,
+// lowest address in the lowest bits. Long strings are scanned four blocks
+// per step once p is aligned to 4 * W; zany4() tells whether such a group
+// holds a zero byte at all.
+
+typedef struct {
+    size_t (*len)(const char *s);
+    size_t (*nlen)(const char *s, size_t max);
+    size_t (*copy)(char *dest, const char *src);   // returns the length
+} StringKernels;
+
+// Copies n <= 32 bytes with at most two overlapping fixed-size moves
+static inline void copy_small(char *d, const char *s, size_t n) {
+    if (n >= 16) {
+        __builtin_memcpy(d, s, 16);
+        __builtin_memcpy(d + n - 16, s + n - 16, 16);
+    } else if (n >= 8) {
+        __builtin_memcpy(d, s, 8);
+        __builtin_memcpy(d + n - 8, s + n - 8, 8);
+    } else if (n >= 4) {
+        __builtin_memcpy(d, s, 4);
+        __builtin_memcpy(d + n - 4, s + n - 4, 4);
+    } else if (n >= 2) {
+        __builtin_memcpy(d, s, 2);
+        __builtin_memcpy(d + n - 2, s + n - 2, 2);
+    } else if (n == 1) {
+        *d = *s;
     }
-    return len; // placeholder
 }
 
-void my_strcpy(char *dest, const char *src) {
-    // TODO: copy characters until '\0'
-    int i = 0;
-    while(src[i] != '\0'){
-        dest[i] = src[i];
+// Copies n bytes of non-overlapping memory
+static void copy_bytes(char *d, const char *s, size_t n) {
+    if (n <= 32) {
+        copy_small(d, s, n);
+        return;
+    }
+    for (size_t i = 0; i + 32 <= n; i += 32) __builtin_memcpy(d + i, s + i, 32);
+    __builtin_memcpy(d + n - 32, s + n - 32, 32);
+}
+
+// Defines the len, nlen and copy kernels for one block width. COPY_W
+// copies W bytes between unaligned addresses.
+#define GROUP_START(p, W) (((uintptr_t)(p) & (4 * (W) - 1)) == 0)
+#define STRING_KERNELS(SFX, TARGET, W, ZBITS, COPY_W)                          \
+    TARGET static size_t len_##SFX(const char *s) {                            \
+        const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)((W) - 1));  \
+        uint64_t m = zmask_##SFX(p, (unsigned)(s - p));                        \
+        while (m == 0) {                                                       \
+            p += (W);                                                          \
+            if (GROUP_START(p, W))                                             \
+                while (!zany4_##SFX(p)) p += 4 * (W);                          \
+            m = zmask_##SFX(p, 0);                                             \
+        }                                                                      \
+        return (size_t)(p - s) + (size_t)__builtin_ctzll(m) / (ZBITS);          \
+    }                                                                          \
+                                                                               \
+    TARGET static size_t nlen_##SFX(const char *s, size_t max) {               \
+        const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)((W) - 1));  \
+        uint64_t m = zmask_##SFX(p, (unsigned)(s - p));                        \
+        while (m == 0) {                                                       \
+            if ((size_t)(p + (W) - s) >= max) return max;                      \
+            p += (W);                                                          \
+            if (GROUP_START(p, W))                                             \
+                while ((size_t)(p + 4 * (W) - s) <= max && !zany4_##SFX(p))    \
+                    p += 4 * (W);                                              \
+            m = zmask_##SFX(p, 0);                                             \
+        }                                                                      \
+        size_t n = (size_t)(p - s) + (size_t)__builtin_ctzll(m) / (ZBITS);      \
+        return n < max ? n : max;                                              \
+    }                                                                          \
+                                                                               \
+    /* Stores only whole blocks known to lie inside the string, then the   */ \
+    /* last W bytes ending at the terminator, overlapping the one before   */ \
+    TARGET static size_t copy_##SFX(char *d, const char *s) {                  \
+        const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)((W) - 1));  \
+        uint64_t m = zmask_##SFX(p, (unsigned)(s - p));                        \
+        size_t n;                                                              \
+        if (m == 0) {                                                          \
+            p += (W);                                                          \
+            m = zmask_##SFX(p, 0);                                             \
+        }                                                                      \
+        if (m != 0) {                                                          \
+            n = (size_t)(p - s) + (size_t)__builtin_ctzll(m) / (ZBITS) + 1;     \
+            if (n <= (W)) {                                                    \
+                copy_small(d, s, n);                                           \
+                return n - 1;                                                  \
+            }                                                                  \
+        }                                                                      \
+        COPY_W(d, s);                                                          \
+        while (m == 0) {                                                       \
+            COPY_W(d + (p - s), p);                                            \
+            p += (W);                                                          \
+            if (GROUP_START(p, W))                                             \
+                for (; !zany4_##SFX(p); p += 4 * (W)) {                        \
+                    COPY_W(d + (p - s), p);                                    \
+                    COPY_W(d + (p - s) + (W), p + (W));                        \
+                    COPY_W(d + (p - s) + 2 * (W), p + 2 * (W));                \
+                    COPY_W(d + (p - s) + 3 * (W), p + 3 * (W));                \
+                }                                                              \
+            m = zmask_##SFX(p, 0);                                             \
+        }                                                                      \
+        n = (size_t)(p - s) + (size_t)__builtin_ctzll(m) / (ZBITS) + 1;         \
+        COPY_W(d + n - (W), s + n - (W));                                      \
+        return n - 1;                                                          \
+    }                                                                          \
+                                                                               \
+    static const StringKernels kernels_##SFX = {len_##SFX, nlen_##SFX, copy_##SFX};
+
+// One byte at a time: the reference versions
+static size_t len_bytes(const char *s) {
+    size_t len = 0;
+    while (s[len] != '\0') len++;
+    return len;
+}
+
+static size_t nlen_bytes(const char *s, size_t max) {
+    size_t len = 0;
+    while (len < max && s[len] != '\0') len++;
+    return len;
+}
+
+static size_t copy_bytes_loop(char *d, const char *s) {
+    size_t i = 0;
+    while (s[i] != '\0') {
+        d[i] = s[i];
         i++;
     }
-    dest[i] = '\0';
-}
\ No newline at end of file
+    d[i] = '\0';
+    return i;
+}
+
+static const StringKernels kernels_bytes = {len_bytes, nlen_bytes, copy_bytes_loop};
+
+#ifdef STR_SWAR
+// 8 bytes per step: (w - 0x01..) & ~w & 0x80.. flags every zero byte in its
+// top bit. Bytes above a zero may be flagged too, which never matters
+// since only the lowest flag is used. Bytes before the string are forced
+// to 0xFF so they can neither match nor cause such false flags.
+typedef uint64_t __attribute__((may_alias)) StrWord;
+
+static inline uint64_t zmask_swar(const char *p, unsigned off) {
+    uint64_t w = *(const StrWord *)p | (((uint64_t)1 << (8 * off)) - 1);
+    return (w - 0x0101010101010101ull) & ~w & 0x8080808080808080ull;
+}
+
+static inline int zany4_swar(const char *p) {
+    const StrWord *w = (const StrWord *)p;
+    uint64_t any = 0;
+    for (int k = 0; k < 4; k++) any |= (w[k] - 0x0101010101010101ull) & ~w[k];
+    return (any & 0x8080808080808080ull) != 0;
+}
+
+#define COPY_8(d, s) __builtin_memcpy((d), (s), 8)
+STRING_KERNELS(swar, , 8, 8, COPY_8)
+#endif
+
+#ifdef STR_X86
+static inline uint64_t zmask_sse2(const char *p, unsigned off) {
+    __m128i v = _mm_load_si128((const __m128i *)p);
+    unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return m & (~0u << off);
+}
+
+// The byte-wise minimum of the group is zero exactly where some byte is
+static inline int zany4_sse2(const char *p) {
+    const __m128i *v = (const __m128i *)p;
+    __m128i lo = _mm_min_epu8(_mm_load_si128(v), _mm_load_si128(v + 1));
+    __m128i hi = _mm_min_epu8(_mm_load_si128(v + 2), _mm_load_si128(v + 3));
+    __m128i z = _mm_cmpeq_epi8(_mm_min_epu8(lo, hi), _mm_setzero_si128());
+    return _mm_movemask_epi8(z) != 0;
+}
+
+__attribute__((target("avx2")))
+static inline int zany4_avx2(const char *p) {
+    const __m256i *v = (const __m256i *)p;
+    __m256i lo = _mm256_min_epu8(_mm256_load_si256(v), _mm256_load_si256(v + 1));
+    __m256i hi = _mm256_min_epu8(_mm256_load_si256(v + 2), _mm256_load_si256(v + 3));
+    __m256i z = _mm256_cmpeq_epi8(_mm256_min_epu8(lo, hi), _mm256_setzero_si256());
+    return _mm256_movemask_epi8(z) != 0;
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t zmask_avx2(const char *p, unsigned off) {
+    __m256i v = _mm256_load_si256((const __m256i *)p);
+    unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    return m & (~0u << off);
+}
+
+#define COPY_16(d, s) _mm_storeu_si128((__m128i *)(d), _mm_loadu_si128((const __m128i *)(s)))
+#define COPY_32(d, s) \
+    _mm256_storeu_si256((__m256i *)(d), _mm256_loadu_si256((const __m256i *)(s)))
+STRING_KERNELS(sse2, , 16, 1, COPY_16)
+STRING_KERNELS(avx2, __attribute__((target("avx2"))), 32, 1, COPY_32)
+#endif
+
+// Picks the widest kernels the CPU supports
+static const StringKernels *string_kernels(void) {
+    static const StringKernels *chosen = NULL;
+
+    if (chosen != NULL) return chosen;
+    chosen = &kernels_bytes;
+#ifdef STR_SWAR
+    chosen = &kernels_swar;
+#endif
+#ifdef STR_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) chosen = &kernels_sse2;
+    if (__builtin_cpu_supports("avx2")) chosen = &kernels_avx2;
+#endif
+    return chosen;
+}
+
+// Implement functions below
+int my_strlen(const char *str) {
+    // Count characters until '\0', a block at a time
+    return (int)string_kernels()->len(str);
+}
+
+void my_strcpy(char *dest, const char *src) {
+    // Copy characters up to and including '\0', a block at a time
+    string_kernels()->copy(dest, src);
+}
+
+size_t my_strlcpy(char *dest, const char *src, size_t size) {
+    if (size == 0) return 0;
+    size_t n = string_kernels()->nlen(src, size - 1);
+    copy_bytes(dest, src, n);
+    dest[n] = '\0';
+    return n;
+}
@@ -0,0 +1,146 @@
+/*
+ * name_arena.c
+ * Bump-allocated, deduplicating name storage; see name_arena.h.
+ */
+
+#include "name_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a; names are short, so a simple byte loop is enough
+static uint32_t name_hash(const char *s, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void arena_init(NameArena *a) {
+    memset(a, 0, sizeof(*a));
+    a->owned = 1;
+}
+
+void arena_free(NameArena *a) {
+    if (a->owned) free(a->data);
+    free(a->table);
+    arena_init(a);
+}
+
+void arena_attach(NameArena *a, char *data, size_t len) {
+    arena_free(a);
+    a->data = data;
+    a->len = a->cap = len;
+    a->owned = 0;
+}
+
+int arena_own(NameArena *a) {
+    if (a->owned) return 1;
+    char *data = malloc(a->len ? a->len : 1);
+    if (data == NULL) return 0;
+    memcpy(data, a->data, a->len);
+    a->data = data;
+    a->cap = a->len ? a->len : 1;
+    a->owned = 1;
+    return 1;
+}
+
+// Puts an offset into a table known to have room for it
+static void table_put(uint64_t *table, size_t mask, uint32_t hash, uint32_t off) {
+    size_t i = hash & mask;
+    while (table[i] != 0) i = (i + 1) & mask;
+    table[i] = (uint64_t)hash << 32 | (off + 1u);
+}
+
+// Looks `s` up; returns the table slot holding it or the empty slot where
+// it would go
+static size_t table_find(const NameArena *a, const char *s, size_t n, uint32_t hash) {
+    size_t i = hash & a->mask;
+    for (; a->table[i] != 0; i = (i + 1) & a->mask) {
+        if ((uint32_t)(a->table[i] >> 32) != hash) continue;
+        const char *t = a->data + (uint32_t)a->table[i] - 1;
+        // strncmp stops at the end of a shorter stored string, so this
+        // never reads past it; `s` has no NUL bytes (see arena_intern)
+        if (strncmp(t, s, n) == 0 && t[n] == '\0') break;
+    }
+    return i;
+}
+
+// Grows the intern table to keep it at most half full. Strings that are in
+// the data but not yet in the table (after arena_attach) are added here.
+static int table_grow(NameArena *a) {
+    size_t nslots = a->table ? 2 * (a->mask + 1) : 64;
+    if (a->table == NULL) {
+        // Size for the attached strings in one go
+        size_t strings = 0;
+        for (size_t i = 0; i < a->len; i++) strings += a->data[i] == '\0';
+        while (nslots < 2 * (strings + 1)) nslots *= 2;
+    }
+    uint64_t *table = calloc(nslots, sizeof(uint64_t));
+    if (table == NULL) return 0;
+
+    if (a->table != NULL) {
+        for (size_t i = 0; i <= a->mask; i++)
+            if (a->table[i] != 0)
+                table_put(table, nslots - 1, (uint32_t)(a->table[i] >> 32),
+                          (uint32_t)a->table[i] - 1);
+        free(a->table);
+        a->table = table;
+        a->mask = nslots - 1;
+        return 1;
+    }
+
+    a->table = table;
+    a->mask = nslots - 1;
+    a->used = 0;
+    // Index attached strings; a repeated one keeps its first offset
+    for (size_t off = 0; off < a->len;) {
+        const char *s = a->data + off;
+        size_t n = strlen(s);
+        uint32_t hash = name_hash(s, n);
+        size_t slot = table_find(a, s, n, hash);
+        if (a->table[slot] == 0) {
+            a->table[slot] = (uint64_t)hash << 32 | (uint32_t)(off + 1);
+            a->used++;
+        }
+        off += n + 1;
+    }
+    return 1;
+}
+
+int arena_intern(NameArena *a, const char *s, size_t n, uint32_t *off) {
+    // Stored names end at their first NUL, so that is where this one ends
+    const char *nul = memchr(s, '\0', n);
+    if (nul != NULL) n = (size_t)(nul - s);
+
+    if ((a->table == NULL || 2 * (a->used + 1) > a->mask + 1) && !table_grow(a))
+        return 0;
+
+    uint32_t hash = name_hash(s, n);
+    size_t slot = table_find(a, s, n, hash);
+    if (a->table[slot] != 0) {
+        *off = (uint32_t)a->table[slot] - 1;
+        return 1;
+    }
+
+    // New name: bump-allocate it at the end of the data
+    if (a->len + n + 1 >= UINT32_MAX) return 0;
+    if (!arena_own(a)) return 0;
+    if (a->len + n + 1 > a->cap) {
+        size_t cap = a->cap + a->cap / 2 + n + 64;
+        char *data = realloc(a->data, cap);
+        if (data == NULL) return 0;
+        a->data = data;
+        a->cap = cap;
+    }
+    memcpy(a->data + a->len, s, n);
+    a->data[a->len + n] = '\0';
+    *off = (uint32_t)a->len;
+    a->len += n + 1;
+
+    a->table[slot] = (uint64_t)hash << 32 | (*off + 1u);
+    a->used++;
+    return 1;
+}
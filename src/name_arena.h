@@ -0,0 +1,47 @@
+/*
+ * name_arena.h
+ * Shared storage for student names.
+ *
+ * Names are copied once into a bump-allocated arena of NUL-terminated
+ * strings and referred to by 32-bit offsets. Interning deduplicates: the
+ * same name always gets the same offset. Names may be any length and may
+ * contain spaces.
+ */
+
+#ifndef NAME_ARENA_H
+#define NAME_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    char *data;         // NUL-terminated strings back to back
+    size_t len;         // bytes used
+    size_t cap;         // bytes allocated
+    int owned;          // 0 while `data` is borrowed (e.g. a file mapping)
+    uint64_t *table;    // intern table: hash << 32 | (offset + 1), 0 = empty
+    size_t mask;        // table slots - 1, or 0 before the table exists
+    size_t used;        // occupied table slots
+} NameArena;
+
+void arena_init(NameArena *a);
+void arena_free(NameArena *a);
+
+// Uses `len` bytes of existing arena data (for example from a mapped file)
+// without copying. The arena copies it on the first intern of a new name.
+void arena_attach(NameArena *a, char *data, size_t len);
+
+// Makes sure the arena owns its data, copying borrowed bytes to the heap.
+// Returns 0 if out of memory.
+int arena_own(NameArena *a);
+
+// Returns the offset of the `n`-byte string `s` in *off, adding it if it is
+// not there yet. A NUL byte in `s` ends the string early. `s` must not point
+// into the arena. Returns 0 if out of memory or the arena would pass 4 GiB.
+int arena_intern(NameArena *a, const char *s, size_t n, uint32_t *off);
+
+static inline const char *arena_get(const NameArena *a, uint32_t off) {
+    return a->data + off;
+}
+
+#endif
@@ -6,15 +6,23 @@
  *   Simple in-memory "database" using an array of structs.
  *   Students will use malloc to allocate space for multiple Student records,
  *   then input, display, and possibly search the data.
+ *   Names are interned in a shared arena, so records hold a 32-bit offset
+ *   and names may be any length and contain spaces.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+
+#include "name_arena.h"
 
-// Define struct Student with fields name, id, grade
+// Define struct Student with fields name, id, grade.
+// `name` is an offset into the name arena.
 struct Student {
-    char name[50];
+    uint32_t name;
     int id;
     float grade;
 };
@@ -23,6 +31,11 @@ int main(void) {
     int n;
     struct Student *students = NULL;
     float totalGrade = 0.0;
+    NameArena names;
+    char *line = NULL;
+    size_t lineCap = 0;
+
+    arena_init(&names);
 
     printf("Enter number of students: ");
     if (scanf("%d", &n) != 1 || n <= 0) {
@@ -41,8 +54,20 @@ int main(void) {
     for (int i = 0; i < n; i++) {
         printf("\n--- Student %d ---\n", i + 1);
 
+        // Drop the rest of the previous line, then read the whole name
+        int c;
+        while ((c = getchar()) != '\n' && c != EOF) {}
         printf("Enter name: ");
-        scanf("%49s", students[i].name);  // %49s prevents overflow
+        ssize_t len = getline(&line, &lineCap, stdin);
+        if (len < 0) len = 0;
+        while (len > 0 && isspace((unsigned char)line[len - 1])) len--;
+        if (!arena_intern(&names, line ? line : "", (size_t)len, &students[i].name)) {
+            printf("Memory allocation failed.\n");
+            free(students);
+            free(line);
+            arena_free(&names);
+            return 1;
+        }
 
         printf("Enter ID: ");
         scanf("%d", &students[i].id);
@@ -57,7 +82,7 @@ int main(void) {
     printf("\n=== Student Records ===\n");
     for (int i = 0; i < n; i++) {
         printf("Name: %-10s | ID: %5d | Grade: %.2f\n",
-               students[i].name, students[i].id, students[i].grade);
+               arena_get(&names, students[i].name), students[i].id, students[i].grade);
     }
 
     // Optional: Compute average grade
@@ -65,6 +90,8 @@ int main(void) {
 
     // Free allocated memory
     free(students);
+    free(line);
+    arena_free(&names);
 
     return 0;
 }
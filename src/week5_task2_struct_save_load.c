@@ -7,58 +7,101 @@
 // Week 5 – Files & Modular Programming
 // TODO: Complete function implementations and file handling logic.
 
+#define _POSIX_C_SOURCE 200809L // For getline
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX_NAME_LEN 50
+#include "name_arena.h"
 
+// `name` is an offset into a NameArena, so names have no length limit
 typedef struct {
-    char name[MAX_NAME_LEN];
+    uint32_t name;
     int age;
     float gpa;
 } Student;
 
 // Function prototypes
-void save_student(Student s, const char *filename);
-Student load_student(const char *filename);
+void save_student(Student s, const NameArena *names, const char *filename);
+Student load_student(NameArena *names, const char *filename);
 
 int main(void) {
+    NameArena names;
+    arena_init(&names);
+
     Student s1;
-    strcpy(s1.name, "Alice");
+    if (!arena_intern(&names, "Alice", strlen("Alice"), &s1.name)) {
+        printf("Out of memory\n");
+        return 1;
+    }
     s1.age = 21;
     s1.gpa = 3.75f;
 
     const char *filename = "student.txt";
     
-    save_student(s1,filename);
+    save_student(s1, &names, filename);
+    Student s2 = load_student(&names, filename);
     
     printf("Loaded Student: \n");
-    printf("Name: %s\n", s1.name);
-    printf("Age: %d\n", s1.age);
-    printf("GPA: %.2f\n", s1.gpa);
+    printf("Name: %s\n", arena_get(&names, s2.name));
+    printf("Age: %d\n", s2.age);
+    printf("GPA: %.2f\n", s2.gpa);
     
+    arena_free(&names);
     return 0;
 }
 
-void save_student(Student s, const char *student) {
+void save_student(Student s, const NameArena *names, const char *student) {
     FILE *fp = fopen(student, "w");
     if (fp == NULL){
         printf("Error opening the file for writing\n");
         exit(1);
     }
-    fprintf(fp, "%s %d %.2f\n", s.name, s.age, s.gpa);
+    fprintf(fp, "%s %d %.2f\n", arena_get(names, s.name), s.age, s.gpa);
     fclose(fp);
 }
 
-Student load_student(const char *student) {
+Student load_student(NameArena *names, const char *student) {
     Student s;
+    char *line = NULL;
+    size_t lineCap = 0;
     FILE*fp = fopen(student,"r");
     if (fp == NULL){
         printf("Error opening the file for reading.\n");
         exit(1);
     }
-    fscanf(fp, "%s %d %f", s.name, &s.age, &s.gpa);
+    // The whole line, however long the name
+    if (getline(&line, &lineCap, fp) < 0) {
+        printf("Error reading the file.\n");
+        free(line);
+        fclose(fp);
+        exit(1);
+    }
     fclose(fp);
+
+    // The name may contain spaces, so take age and GPA from the end
+    char *gpa = strrchr(line, ' ');
+    if (gpa == NULL) {
+        printf("Malformed record.\n");
+        free(line);
+        exit(1);
+    }
+    *gpa++ = '\0';
+    char *age = strrchr(line, ' ');
+    if (age == NULL) {
+        printf("Malformed record.\n");
+        free(line);
+        exit(1);
+    }
+    *age++ = '\0';
+    s.age = atoi(age);
+    s.gpa = strtof(gpa, NULL);
+    if (!arena_intern(names, line, strlen(line), &s.name)) {
+        printf("Out of memory\n");
+        free(line);
+        exit(1);
+    }
+    free(line);
     return s;
 }
@@ -1,50 +1,461 @@
+#define _POSIX_C_SOURCE 200809L // For fsync, mmap and fork
+
 #include <stdio.h>
 #include <stdlib.h> // For EXIT_SUCCESS/FAILURE, which might be good practice
 #include <string.h> // For string functions like strcpy
+#include <ctype.h>
+#include <stdint.h> // For SIZE_MAX and fixed-width header fields
+#include <limits.h>
+#include <math.h>   // For INFINITY
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "name_arena.h"
 
-// Maximum number of students the array can hold
-#define MAX_STUDENTS 100
-// Maximum length of a student's name
-#define NAME_LEN 50
-// Name of the data file
-#define DATA_FILE "students.txt"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SMS_X86 1
+#endif
 
-// Student structure definition
+// Initial capacity of the record store; it grows on demand
+#define INITIAL_CAPACITY 16
+// Name field width of version 1 data files
+#define V1_NAME_LEN 50
+// Name of the binary data file
+#define DATA_FILE "students.db"
+// Legacy text data file, imported automatically if DATA_FILE does not exist
+#define TEXT_FILE "students.txt"
+// Binary format identification
+#define FILE_MAGIC "STDB"
+#define FILE_VERSION 2
+// Write-ahead log of changes made since DATA_FILE was last written
+#define WAL_FILE "students.wal"
+#define WAL_MAGIC "STWL"
+#define WAL_VERSION 2
+// Compact once the log holds this many records and more than half as many
+// as the store
+#define COMPACT_MIN 4096
+// GPA histogram: HIST_BINS equal bins over [HIST_MIN, HIST_MAX]; values
+// outside the range count towards the first or last bin
+#define HIST_BINS 8
+#define HIST_MIN 0.0f
+#define HIST_MAX 4.0f
+// Rows per pass of the aggregate kernels between folds of their counters
+#define AGG_BLOCK (1 << 20)
+// Reader threads that can be registered with one SharedStore at a time
+#define MAX_READERS 64
+// Bytes read at a time when importing; longer lines grow the buffer
+#define IMPORT_CHUNK (1 << 20)
+// Records the import subcommand adds between two publishes
+#define IMPORT_PUBLISH (1 << 16)
+// Columns looked at in a CSV/TSV line; later ones are ignored
+#define MAX_FIELDS 16
+// External sort: smallest I/O buffer per file (which also sets how many
+// runs one merge can take) and the most threads used for run generation
+#define SORT_MIN_BUF (1 << 20)
+#define MAX_SORT_THREADS 64
+// Radix histogram (16-bit digits) each run-sorting thread allocates
+#define SORT_HIST_BYTES (65536 * sizeof(size_t))
+// Default memory budget of the sort subcommand, in MiB
+#define SORT_DEFAULT_MB 256
+
+// Student structure definition. The store keeps records column by column
+// (see StudentStore); this is the row form used for input and the log.
+// `name` points at storage owned by the caller or the store.
 typedef struct {
-    char name[NAME_LEN];
+    const char *name;
     int id;
     float gpa;
 } Student;
 
+// Record layout of version 1 data files
+typedef struct {
+    char name[V1_NAME_LEN];
+    int id;
+    float gpa;
+} StudentV1;
+
+// Header of DATA_FILE. It is followed by the store's columns exactly as
+// laid out in memory (host byte order), so the file can be mapped and used
+// in place: `count` ids, `count` GPAs, `count` name offsets, then the
+// `names_len`-byte name heap. `checksum` covers all four sections.
+typedef struct {
+    char magic[4];        // FILE_MAGIC
+    uint32_t version;     // FILE_VERSION
+    uint64_t count;
+    uint64_t names_len;
+    uint64_t checksum;
+} FileHeader;
+
+// Version 1 header: `count` fixed-width StudentV1 records followed. Such
+// files are still read and are rewritten as version 2 on the next save.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t checksum;
+} FileHeaderV1;
+
+// Optional filter for the GPA aggregates: rows match if both their GPA and
+// id fall inside the (inclusive) ranges. Rows with a NaN GPA never match.
+typedef struct {
+    float gpa_lo, gpa_hi;
+    int id_lo, id_hi;
+} GpaFilter;
+
+// Result of gpa_aggregate()
+typedef struct {
+    size_t count;
+    double mean;
+    float min, max;
+    size_t hist[HIST_BINS];
+} GpaStats;
+
+// Formats of the files read by import and written by export
+typedef enum {
+    FORMAT_TEXT,   // "name id gpa" per line, the legacy students.txt format
+    FORMAT_CSV,    // comma-separated with a header line
+    FORMAT_TSV     // tab-separated with a header line
+} RecordFormat;
+
+// Orders the sort subcommand can produce
+typedef enum { SORT_ID, SORT_NAME, SORT_GPA } SortKey;
+
+// Log record types. Both are idempotent (PUT is an upsert, DELETE of a
+// missing id is a no-op), so replaying records that are already reflected
+// in DATA_FILE is harmless.
+enum { WAL_PUT = 1, WAL_DELETE = 2 };
+
+// Fixed part of a log record; `name_len` bytes of name follow it. `check`
+// is the low half of the checksum of the whole record with `check` set to
+// 0, so a torn final write is detected.
+typedef struct {
+    uint32_t op;
+    uint32_t check;
+    int32_t id;
+    float gpa;
+    uint32_t name_len;
+} WalRecord;
+
+// Write-ahead log with group commit: records are appended to an in-memory
+// buffer, and the first caller that needs them durable writes and fsyncs
+// everything buffered so far while later callers wait for that sync.
+typedef struct {
+    const char *path;
+    int fd;
+    pthread_mutex_t lock;
+    pthread_cond_t synced;
+    char *buf;             // records appended but not yet written
+    size_t len, cap;       // in bytes
+    size_t buffered;       // records in `buf`
+    uint64_t appended;     // sequence number of the last appended record
+    uint64_t durable;      // sequence number of the last fsynced record
+    int syncing;           // a leader is currently writing + fsyncing
+    int failed;            // a write or fsync failed; the log is unusable
+    off_t size;            // bytes written to the file
+    size_t records;        // records in the file
+    pid_t compactor;       // child writing a new DATA_FILE, or 0
+    off_t compact_from;    // log offset covered by that DATA_FILE
+    size_t compact_records; // records before compact_from
+} Wal;
+
+// Position value marking an empty index slot / a missing record
+#define NOT_FOUND SIZE_MAX
+
+// Open-addressing hash index from student id to position in the store.
+// Linear probing, kept at most half full; deletes shift later entries back
+// instead of leaving tombstones, so probe chains stay short.
+typedef struct {
+    int id;
+    size_t pos;       // NOT_FOUND if the slot is empty
+} IndexSlot;
+
+typedef struct {
+    IndexSlot *slots;
+    size_t mask;      // slot count - 1 (slot count is a power of two)
+    unsigned shift;   // 64 - log2(slot count), for Fibonacci hashing
+    size_t used;
+} IdIndex;
+
+// Secondary index on GPA: every (gpa, id) pair packed into one 64-bit key
+// that sorts by GPA, then id, kept in a sorted array. It is built on the
+// first GPA query (bulk loads never pay for it) and then maintained by
+// binary search + memmove on each change, so range and top-K queries cost
+// O(log n + k).
+typedef struct {
+    uint64_t *keys;
+    size_t count, cap;
+    int built;
+} GpaIndex;
+
+// Growable columnar record store. Each field is its own array so scans
+// over one field (GPA aggregates) touch only that field's bytes. Names are
+// interned in a NameArena and addressed by 32-bit offsets; replaced and
+// deleted names may leave dead bytes, which are compacted away once they
+// could make up half the arena. The columns grow geometrically (x1.5) so
+// appends are amortized O(1). The id index is updated by every operation
+// that adds, moves or removes a record.
+// After load_students() every array points into a private (copy-on-write)
+// mapping of DATA_FILE; the first append copies them to the heap.
+typedef struct {
+    int *ids;
+    float *gpas;
+    uint32_t *name_offs;
+    size_t count;     // records in use
+    size_t capacity;  // records allocated per column
+    NameArena names;  // interned, so records with the same name share bytes
+    size_t names_dead; // upper bound on bytes no record refers to any more
+    IdIndex index;
+    GpaIndex gpa;     // see store_gpa_index()
+    void *map;        // file mapping backing the arrays, or NULL
+    size_t map_len;
+} StudentStore;
+
+// Read-side registration of one reader thread of a SharedStore. `epoch`
+// is 0 while the thread is outside a read section, otherwise the publish
+// epoch it entered in. Each slot has its own cache line, so readers never
+// write to memory another thread uses.
+typedef struct {
+    _Alignas(64) _Atomic uint64_t epoch;
+    atomic_int in_use;
+} ReaderSlot;
+
+// Store shared by one writer thread and any number of reader threads.
+// It keeps two identical copies of the records: readers use the published
+// copy without taking locks while the writer changes the other one.
+// shared_publish() swaps the two and retires the old published version;
+// once a grace period has passed with no reader still inside it (as in
+// RCU), the batch of changes is replayed into it and it becomes the
+// writer's copy. A read section therefore always sees one consistent
+// state, and reads scale with cores because they share no written data.
+typedef struct {
+    StudentStore copy[2];
+    atomic_int current;          // copy readers use
+    _Atomic uint64_t epoch;      // bumped by every publish, starts at 1
+    ReaderSlot readers[MAX_READERS];
+    char *pending;               // changes the published copy has not seen, as
+    size_t len, cap;             // WalRecords each followed by its name + NUL
+    size_t changes;              // records in `pending`
+    int failed;                  // the copies diverged; writes are refused
+} SharedStore;
+
 // function prototypes
-// Loads students from the file, returns number of records loaded
-int load_students(Student arr[]);
-// Saves all students to the file
-void save_students(Student arr[], int count);
+// Record store management
+void store_init(StudentStore *store);
+void store_free(StudentStore *store);
+// Makes room for at least `capacity` records, returns 0 on allocation failure
+int store_reserve(StudentStore *store, size_t capacity);
+// Releases unused capacity
+void store_shrink(StudentStore *store);
+// Appends a record. Returns 1 on success, 0 if its id already exists, -1 if
+// out of memory.
+int store_add(StudentStore *store, const Student *rec);
+// Returns the position of the record with the given id, or NOT_FOUND
+size_t store_find(const StudentStore *store, int id);
+// Name of the record at `pos`
+const char *store_name(const StudentStore *store, size_t pos);
+// Copies the record at `pos` into row form
+void store_get(const StudentStore *store, size_t pos, Student *out);
+// Removes the record with the given id; the last record takes its place.
+// Returns 0 if there is no such record.
+int store_delete(StudentStore *store, int id);
+// Inserts or overwrites the record with rec->id. Returns 0 if out of memory.
+int store_put(StudentStore *store, const Student *rec);
+// Changes the name of the record at `pos`. Returns 0 if out of memory.
+int store_set_name(StudentStore *store, size_t pos, const char *name);
+// Changes the GPA of the record at `pos`, keeping the GPA index in step
+void store_set_gpa(StudentStore *store, size_t pos, float gpa);
+// Returns the GPA index, building it first if needed, or NULL if out of memory
+const GpaIndex *store_gpa_index(StudentStore *store);
+// GPA index management
+void gpa_free(GpaIndex *gpa);
+uint64_t gpa_key(float gpa, int id);
+int gpa_key_id(uint64_t key);
+int gpa_build(GpaIndex *gpa, const int *ids, const float *gpas, size_t count);
+// First position whose key is >= `key`
+size_t gpa_lower_bound(const GpaIndex *gpa, uint64_t key);
+int gpa_insert(GpaIndex *gpa, float value, int id);
+void gpa_remove(GpaIndex *gpa, float value, int id);
+// Id index management
+void index_init(IdIndex *index);
+void index_free(IdIndex *index);
+size_t index_find(const IdIndex *index, int id);
+int index_insert(IdIndex *index, int id, size_t pos);
+// Sizes the table for `n` ids so inserting them does not rehash
+int index_reserve(IdIndex *index, size_t n);
+void index_set(IdIndex *index, int id, size_t pos);
+void index_remove(IdIndex *index, int id);
+// Reads an integer id from stdin after printing `prompt`
+int read_id(const char *prompt);
+// Reads a non-empty line (a name, spaces allowed) from stdin after printing
+// `prompt`. The caller frees the result. Returns NULL at end of input.
+char *read_name(const char *prompt);
+// Maps a binary data file into the (empty) store. A missing file is not an
+// error. Returns 0 on success, -1 if the file is unreadable or corrupt.
+int load_students(StudentStore *store, const char *path);
+// Writes the store to a binary data file. Returns 0 on success, -1 on error.
+int save_students(const StudentStore *store, const char *path);
+// Picks the format from the file name: .csv, .tsv, anything else is text
+RecordFormat format_of(const char *path);
+// Appends the records of a text, CSV or TSV file ("-" reads stdin). Records
+// whose id is already present are skipped. Returns the number of records
+// added, or -1 if the file cannot be opened or read.
+long import_records(StudentStore *store, const char *path, RecordFormat format);
+// Parses one line of the text format in place; returns 0 if malformed
+int parse_record(char *line, Student *out);
+// Splits one CSV/TSV line in place into at most `max` fields and returns
+// how many the line has. A field may be quoted ("...") to hold the
+// delimiter; "" inside quotes stands for one quote.
+int split_fields(char *line, char delim, char **field, int max);
+// Writes the store in the given format ("-" writes stdout). Returns 0 on
+// success.
+int export_records(const StudentStore *store, const char *path, RecordFormat format);
+// Sorts a text, CSV or TSV file of any size into `out` using about `budget`
+// bytes of memory: sorted runs are generated with `threads` threads and
+// k-way merged through temporary files next to `out`. Returns the number
+// of records written, or -1 on error.
+long sort_records(const char *in, RecordFormat in_format, const char *out, RecordFormat out_format,
+                  SortKey key, size_t budget, int threads);
+// Checksum over `len` raw bytes
+uint64_t checksum_bytes(const void *data, size_t len);
+// Count, mean, min, max and histogram of gpas[0, n) in one SIMD pass.
+// `ids` and `filter` may be NULL for an unfiltered scan.
+void gpa_aggregate(const int *ids, const float *gpas, size_t n,
+                   const GpaFilter *filter, GpaStats *out);
+// Write-ahead log. wal_open() replays the log into the store and returns the
+// number of records applied, or -1 on error.
+long wal_open(Wal *wal, const char *path, StudentStore *store);
+void wal_close(Wal *wal);
+// Buffers one change and returns its sequence number, or 0 if the name is
+// longer than WAL_NAME_MAX (only that record is rejected)
+uint64_t wal_append(Wal *wal, int op, const Student *rec);
+// Waits until every record up to `seq` is on disk. Returns 0 on success.
+int wal_sync(Wal *wal, uint64_t seq);
+// Appends a change and waits for it to be durable. Returns 0 on success.
+int wal_log(Wal *wal, int op, const Student *rec);
+// Empties the log once DATA_FILE holds everything in it
+int wal_reset(Wal *wal);
+// Starts writing DATA_FILE in a background process if none is running
+void wal_compact(Wal *wal, const StudentStore *store);
+// Finishes a background compaction if it has exited (or waits for it)
+void wal_poll_compaction(Wal *wal, int wait);
+// Compacts automatically once the log is large relative to the store
+void wal_maybe_compact(Wal *wal, const StudentStore *store);
+// Shared store. shared_open() takes over the records of `store` (left
+// empty) and copies them; returns 0 on success, -1 if out of memory, in
+// which case `store` is unchanged.
+int shared_open(SharedStore *shared, StudentStore *store);
+// Hands the writer's copy, with every change so far, back in `store` (or
+// frees it if `store` is NULL). No reader may be inside a read section.
+void shared_close(SharedStore *shared, StudentStore *store);
+// Claims a reader slot for the calling thread; returns it, or -1 if all
+// MAX_READERS are taken
+int shared_reader_register(SharedStore *shared);
+void shared_reader_unregister(SharedStore *shared, int reader);
+// Starts a read section and returns the published copy, which stays valid
+// and unchanged until shared_read_end()
+const StudentStore *shared_read_begin(SharedStore *shared, int reader);
+void shared_read_end(SharedStore *shared, int reader);
+// Writer side: changes become visible to readers at the next publish.
+// Both return 0 if out of memory or after a failed publish.
+int shared_put(SharedStore *shared, const Student *rec);
+int shared_delete(SharedStore *shared, int id);
+// The writer's own view, including unpublished changes
+const StudentStore *shared_latest(const SharedStore *shared);
+// Makes all changes so far visible to readers. Returns 0 on success.
+int shared_publish(SharedStore *shared);
+// Like import_records(), but a loader thread adds the records through a
+// SharedStore while the calling thread reports progress from snapshots
+long import_with_progress(StudentStore *store, const char *path, RecordFormat format);
 // Adds a new student record
-void add_student(Student arr[], int *count);
+void add_student(StudentStore *store, Wal *wal);
 // Prints all student records to the console
-void list_students(Student arr[], int count);
+void list_students(const StudentStore *store);
+// Looks up and prints a single student by id
+void find_student(const StudentStore *store);
+// Changes the name and GPA of a student by id
+void update_student(StudentStore *store, Wal *wal);
+// Removes a student by id
+void delete_student(StudentStore *store, Wal *wal);
+// Prints the students whose GPA lies in a range, highest first
+void gpa_range_query(StudentStore *store);
+// Prints the K students with the highest GPA
+void top_students(StudentStore *store);
+// Prints GPA count, mean, min, max and histogram, optionally filtered
+void gpa_statistics(const StudentStore *store);
+// Runs a command-line subcommand (import, export, get, stats) instead of
+// the menu. Returns the process exit status.
+int run_command(StudentStore *store, Wal *wal, int argc, char **argv);
+// Runs `sort`, which works on files only and never opens the store
+int sort_command(int argc, char **argv);
 
 // --- MAIN FUNCTION ---
-int main(void) {
-    // Array to hold student records
-    Student students[MAX_STUDENTS];
-    // Current number of students in the array, initialized to 0
-    int count = 0;
+int main(int argc, char **argv) {
+    // Store holding all student records
+    StudentStore students;
+    // Log of changes since DATA_FILE was written
+    Wal wal;
     // User's menu choice
     int choice;
 
+    // Sorting does not touch the store, so it must not map, replay or
+    // create its files either
+    if (argc > 1 && strcmp(argv[1], "sort") == 0)
+        return sort_command(argc, argv);
+
+    store_init(&students);
+
     // TODO: load existing data from file using load_students()
-    count = load_students(students);
-    printf("Loaded %d student record(s) from file.\n\n", count);
+    int fresh = access(DATA_FILE, F_OK) != 0;
+    if (load_students(&students, DATA_FILE) != 0)
+        return EXIT_FAILURE;
+    long replayed = wal_open(&wal, WAL_FILE, &students);
+    if (replayed < 0)
+        return EXIT_FAILURE;
+
+    // First run after the switch to the binary format: pick up the old file.
+    // Subcommands report it on stderr so `export -` output stays clean.
+    if (fresh && replayed == 0 && access(TEXT_FILE, F_OK) == 0) {
+        long added = import_records(&students, TEXT_FILE, FORMAT_TEXT);
+        if (added >= 0 && save_students(&students, DATA_FILE) == 0)
+            fprintf(argc > 1 ? stderr : stdout, "Imported %ld record(s) from %s.\n",
+                    added, TEXT_FILE);
+    }
+
+    // Non-interactive use: run one subcommand without the menu
+    if (argc > 1) {
+        int status = run_command(&students, &wal, argc, argv);
+        wal_close(&wal);
+        store_free(&students);
+        return status;
+    }
+
+    printf("Loaded %zu student record(s) from file", students.count);
+    if (replayed > 0)
+        printf(" (%ld change(s) replayed from %s)", replayed, WAL_FILE);
+    printf(".\n\n");
 
     do {
         printf("--- Student Management System ---\n");
         printf("1. List students\n");
         printf("2. Add student\n");
-        printf("3. Save and Exit\n");
-        printf("4. Exit without Saving\n");
+        printf("3. Find student by ID\n");
+        printf("4. Update student\n");
+        printf("5. Delete student\n");
+        printf("6. List students by GPA range\n");
+        printf("7. Top students by GPA\n");
+        printf("8. GPA statistics\n");
+        printf("9. Compact data file\n");
+        printf("10. Exit\n");
         printf("---------------------------------\n");
         printf("Select an option: ");
 
@@ -57,162 +468,2723 @@ int main(void) {
             while (getchar() != '\n'); // Clear the newline from the buffer
         }
 
+        // Pick up a finished background compaction
+        wal_poll_compaction(&wal, 0);
+
         switch (choice) {
             case 1:
                 // TODO: Call list_students()
-                list_students(students, count);
+                list_students(&students);
                 break;
             case 2:
                 // TODO: Call add_student()
-                add_student(students, &count);
+                add_student(&students, &wal);
                 break;
             case 3:
-                // TODO: Call save_students() and exit loop
-                save_students(students, count);
-                printf("All student records saved to %s.\n", DATA_FILE);
+                find_student(&students);
                 break;
             case 4:
-                printf("Exiting without saving.\n");
+                update_student(&students, &wal);
+                break;
+            case 5:
+                delete_student(&students, &wal);
+                break;
+            case 6:
+                gpa_range_query(&students);
+                break;
+            case 7:
+                top_students(&students);
+                break;
+            case 8:
+                gpa_statistics(&students);
+                break;
+            case 9:
+                // Changes are already durable in the log; this only folds
+                // them into DATA_FILE so the log stays short
+                wal_compact(&wal, &students);
+                printf("Compacting %s in the background.\n\n", DATA_FILE);
+                break;
+            case 10:
+                printf("All changes are saved in %s and %s.\n", DATA_FILE, WAL_FILE);
                 break;
             default:
                 printf("\n** Invalid option. Try again. **\n\n");
                 break;
         }
 
-    } while (choice != 3 && choice != 4);
+    } while (choice != 10);
 
+    wal_close(&wal);
+    store_free(&students);
     return 0;
 }
 
 // --- FUNCTION DEFINITIONS ---
 
-// Open DATA_FILE, read records until EOF, return number of records loaded
-int load_students(Student arr[]) {
-    FILE *fp;
-    int records_loaded = 0;
+void store_init(StudentStore *store) {
+    memset(store, 0, sizeof(*store));
+    arena_init(&store->names);
+    index_init(&store->index);
+}
 
-    // Open the file for reading ("r")
-    fp = fopen(DATA_FILE, "r");
+void store_free(StudentStore *store) {
+    if (store->map != NULL) {
+        munmap(store->map, store->map_len);
+    } else {
+        free(store->ids);
+        free(store->gpas);
+        free(store->name_offs);
+    }
+    arena_free(&store->names);
+    index_free(&store->index);
+    gpa_free(&store->gpa);
+    store_init(store);
+}
 
-    // Check if the file opened successfully
-    if (fp == NULL) {
+// Copies every column out of the file mapping into heap buffers with room
+// for `capacity` records, so they can be grown. Returns 0 if out of memory.
+static int store_unmap(StudentStore *store, size_t capacity) {
+    if (capacity < store->count) capacity = store->count;
+    if (capacity == 0) capacity = 1;
+
+    int *ids = malloc(capacity * sizeof(int));
+    float *gpas = malloc(capacity * sizeof(float));
+    uint32_t *offs = malloc(capacity * sizeof(uint32_t));
+    if (ids == NULL || gpas == NULL || offs == NULL || !arena_own(&store->names)) {
+        free(ids);
+        free(gpas);
+        free(offs);
+        return 0;
+    }
+    memcpy(ids, store->ids, store->count * sizeof(int));
+    memcpy(gpas, store->gpas, store->count * sizeof(float));
+    memcpy(offs, store->name_offs, store->count * sizeof(uint32_t));
+    munmap(store->map, store->map_len);
+
+    store->map = NULL;
+    store->map_len = 0;
+    store->ids = ids;
+    store->gpas = gpas;
+    store->name_offs = offs;
+    store->capacity = capacity;
+    return 1;
+}
+
+int store_reserve(StudentStore *store, size_t capacity) {
+    if (capacity <= store->capacity) return 1;
+    if (capacity > SIZE_MAX / sizeof(int)) return 0;
+    if (store->map != NULL) return store_unmap(store, capacity);
+
+    // Each column is updated as soon as its realloc succeeds, so a failure
+    // part way through leaves some columns larger than needed, never smaller
+    int *ids = realloc(store->ids, capacity * sizeof(int));
+    if (ids == NULL) return 0;
+    store->ids = ids;
+    float *gpas = realloc(store->gpas, capacity * sizeof(float));
+    if (gpas == NULL) return 0;
+    store->gpas = gpas;
+    uint32_t *offs = realloc(store->name_offs, capacity * sizeof(uint32_t));
+    if (offs == NULL) return 0;
+    store->name_offs = offs;
+
+    store->capacity = capacity;
+    return 1;
+}
+
+// Makes room for one more record
+static int store_grow(StudentStore *store) {
+    if (store->count < store->capacity) return 1;
+    size_t grown = store->capacity < INITIAL_CAPACITY
+                       ? INITIAL_CAPACITY
+                       : store->capacity + store->capacity / 2;
+    // Fall back to an exact fit if the geometric step cannot be allocated
+    return store_reserve(store, grown) || store_reserve(store, store->count + 1);
+}
+
+// Interns `name` and returns its offset in *off. Returns 0 if out of memory.
+static int names_add(StudentStore *store, const char *name, uint32_t *off) {
+    // The arena may need to grow, which it cannot do inside the file mapping
+    if (store->map != NULL && !store_unmap(store, store->capacity)) return 0;
+    return arena_intern(&store->names, name, strlen(name), off);
+}
+
+// Re-interns the live names into a fresh arena, dropping unused bytes
+static void names_compact(StudentStore *store) {
+    NameArena fresh;
+    uint32_t *offs;
+
+    if (store->map != NULL && !store_unmap(store, store->capacity)) return;
+    offs = malloc((store->count ? store->count : 1) * sizeof(uint32_t));
+    if (offs == NULL) return;
+    arena_init(&fresh);
+    for (size_t i = 0; i < store->count; i++) {
+        const char *name = store_name(store, i);
+        if (!arena_intern(&fresh, name, strlen(name), &offs[i])) {
+            arena_free(&fresh);
+            free(offs);
+            return;
+        }
+    }
+    memcpy(store->name_offs, offs, store->count * sizeof(uint32_t));
+    free(offs);
+    arena_free(&store->names);
+    store->names = fresh;
+    store->names_dead = 0;
+}
+
+void store_shrink(StudentStore *store) {
+    if (store->map != NULL) return;
+    if (store->count < store->capacity && store->count > 0) {
+        // A failed shrink leaves the larger block in place, which is still valid
+        int *ids = realloc(store->ids, store->count * sizeof(int));
+        if (ids != NULL) store->ids = ids;
+        float *gpas = realloc(store->gpas, store->count * sizeof(float));
+        if (gpas != NULL) store->gpas = gpas;
+        uint32_t *offs = realloc(store->name_offs, store->count * sizeof(uint32_t));
+        if (offs != NULL) store->name_offs = offs;
+        if (ids != NULL && gpas != NULL && offs != NULL) store->capacity = store->count;
+    }
+    if (store->names.len < store->names.cap && store->names.len > 0) {
+        char *names = realloc(store->names.data, store->names.len);
+        if (names != NULL) {
+            store->names.data = names;
+            store->names.cap = store->names.len;
+        }
+    }
+}
+
+int store_add(StudentStore *store, const Student *rec) {
+    uint32_t off;
+    size_t pos = store->count;
+
+    if (index_find(&store->index, rec->id) != NOT_FOUND) return 0;
+    if (!store_grow(store) || !names_add(store, rec->name, &off)) return -1;
+    if (!index_insert(&store->index, rec->id, pos)) {
+        store->names_dead += strlen(rec->name) + 1;
+        return -1;
+    }
+    store->ids[pos] = rec->id;
+    store->gpas[pos] = rec->gpa;
+    store->name_offs[pos] = off;
+    // A GPA index that cannot grow is dropped and rebuilt on the next query
+    if (store->gpa.built && !gpa_insert(&store->gpa, rec->gpa, rec->id))
+        gpa_free(&store->gpa);
+    store->count++;
+    return 1;
+}
+
+size_t store_find(const StudentStore *store, int id) {
+    return index_find(&store->index, id);
+}
+
+const char *store_name(const StudentStore *store, size_t pos) {
+    return arena_get(&store->names, store->name_offs[pos]);
+}
+
+void store_get(const StudentStore *store, size_t pos, Student *out) {
+    out->name = store_name(store, pos);
+    out->id = store->ids[pos];
+    out->gpa = store->gpas[pos];
+}
+
+int store_delete(StudentStore *store, int id) {
+    size_t pos = index_find(&store->index, id);
+    if (pos == NOT_FOUND) return 0;
+
+    index_remove(&store->index, id);
+    if (store->gpa.built)
+        gpa_remove(&store->gpa, store->gpas[pos], id);
+    store->names_dead += strlen(store_name(store, pos)) + 1;
+    store->count--;
+    // Swap-remove: move the last record into the hole and re-point its entry
+    if (pos != store->count) {
+        store->ids[pos] = store->ids[store->count];
+        store->gpas[pos] = store->gpas[store->count];
+        store->name_offs[pos] = store->name_offs[store->count];
+        index_set(&store->index, store->ids[pos], pos);
+    }
+    return 1;
+}
+
+int store_put(StudentStore *store, const Student *rec) {
+    size_t pos = store_find(store, rec->id);
+    if (pos == NOT_FOUND) return store_add(store, rec) > 0;
+    if (!store_set_name(store, pos, rec->name)) return 0;
+    store_set_gpa(store, pos, rec->gpa);
+    return 1;
+}
+
+int store_set_name(StudentStore *store, size_t pos, const char *name) {
+    uint32_t off;
+    const char *old = store_name(store, pos);
+    if (strcmp(old, name) == 0) return 1;
+
+    size_t old_len = strlen(old) + 1;
+    if (!names_add(store, name, &off)) return 0;
+    store->name_offs[pos] = off;
+    // The old name may still be used by other records; count it as dead
+    // anyway, which at worst compacts a little early
+    store->names_dead += old_len;
+    if (store->names_dead > 4096 && store->names_dead > store->names.len / 2)
+        names_compact(store);
+    return 1;
+}
+
+void store_set_gpa(StudentStore *store, size_t pos, float gpa) {
+    int id = store->ids[pos];
+    if (store->gpa.built && gpa_key(gpa, id) != gpa_key(store->gpas[pos], id)) {
+        gpa_remove(&store->gpa, store->gpas[pos], id);
+        if (!gpa_insert(&store->gpa, gpa, id))
+            gpa_free(&store->gpa);
+    }
+    store->gpas[pos] = gpa;
+}
+
+const GpaIndex *store_gpa_index(StudentStore *store) {
+    if (!store->gpa.built && !gpa_build(&store->gpa, store->ids, store->gpas, store->count))
+        return NULL;
+    return &store->gpa;
+}
+
+// --- GPA INDEX ---
+
+void gpa_free(GpaIndex *gpa) {
+    free(gpa->keys);
+    memset(gpa, 0, sizeof(*gpa));
+}
+
+// Maps the float's bits to an unsigned value with the same order (negative
+// values are flipped entirely, positive ones get the sign bit set), and the
+// id to an unsigned value by flipping its sign bit
+uint64_t gpa_key(float gpa, int id) {
+    uint32_t bits;
+    memcpy(&bits, &gpa, sizeof(bits));
+    bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    return (uint64_t)bits << 32 | ((uint32_t)id ^ 0x80000000u);
+}
+
+int gpa_key_id(uint64_t key) {
+    return (int)((uint32_t)key ^ 0x80000000u);
+}
+
+// LSD radix sort in four 16-bit passes; the keys are dense and uniform
+// enough that this beats qsort by a wide margin at millions of records
+int gpa_build(GpaIndex *gpa, const int *ids, const float *gpas, size_t count) {
+    uint64_t *keys = malloc((count ? count : 1) * sizeof(uint64_t));
+    uint64_t *tmp = malloc((count ? count : 1) * sizeof(uint64_t));
+    size_t *hist = malloc(65536 * sizeof(size_t));
+    if (keys == NULL || tmp == NULL || hist == NULL) {
+        free(keys);
+        free(tmp);
+        free(hist);
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) keys[i] = gpa_key(gpas[i], ids[i]);
+
+    for (int shift = 0; shift < 64; shift += 16) {
+        memset(hist, 0, 65536 * sizeof(size_t));
+        for (size_t i = 0; i < count; i++) hist[(keys[i] >> shift) & 0xFFFF]++;
+        size_t sum = 0;
+        for (size_t b = 0; b < 65536; b++) {
+            size_t n = hist[b];
+            hist[b] = sum;
+            sum += n;
+        }
+        for (size_t i = 0; i < count; i++) tmp[hist[(keys[i] >> shift) & 0xFFFF]++] = keys[i];
+        uint64_t *swap = keys;
+        keys = tmp;
+        tmp = swap;
+    }
+    free(tmp);
+    free(hist);
+
+    free(gpa->keys);
+    gpa->keys = keys;
+    gpa->count = count;
+    gpa->cap = count ? count : 1;
+    gpa->built = 1;
+    return 1;
+}
+
+size_t gpa_lower_bound(const GpaIndex *gpa, uint64_t key) {
+    size_t lo = 0, hi = gpa->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (gpa->keys[mid] < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int gpa_insert(GpaIndex *gpa, float value, int id) {
+    if (gpa->count == gpa->cap) {
+        size_t cap = gpa->cap + gpa->cap / 2 + INITIAL_CAPACITY;
+        uint64_t *keys = realloc(gpa->keys, cap * sizeof(uint64_t));
+        if (keys == NULL) return 0;
+        gpa->keys = keys;
+        gpa->cap = cap;
+    }
+    uint64_t key = gpa_key(value, id);
+    size_t pos = gpa_lower_bound(gpa, key);
+    memmove(&gpa->keys[pos + 1], &gpa->keys[pos], (gpa->count - pos) * sizeof(uint64_t));
+    gpa->keys[pos] = key;
+    gpa->count++;
+    return 1;
+}
+
+void gpa_remove(GpaIndex *gpa, float value, int id) {
+    uint64_t key = gpa_key(value, id);
+    size_t pos = gpa_lower_bound(gpa, key);
+    if (pos == gpa->count || gpa->keys[pos] != key) return;
+    memmove(&gpa->keys[pos], &gpa->keys[pos + 1], (gpa->count - pos - 1) * sizeof(uint64_t));
+    gpa->count--;
+}
+
+// --- ID INDEX ---
+
+void index_init(IdIndex *index) {
+    index->slots = NULL;
+    index->mask = 0;
+    index->shift = 64;
+    index->used = 0;
+}
+
+void index_free(IdIndex *index) {
+    free(index->slots);
+    index_init(index);
+}
+
+// Fibonacci hashing: the top bits of id * 2^64/phi spread sequential ids
+static size_t index_home(const IdIndex *index, int id) {
+    return (size_t)(((uint64_t)(uint32_t)id * 0x9E3779B97F4A7C15ull) >> index->shift);
+}
+
+size_t index_find(const IdIndex *index, int id) {
+    if (index->slots == NULL) return NOT_FOUND;
+    for (size_t i = index_home(index, id);; i = (i + 1) & index->mask) {
+        const IndexSlot *slot = &index->slots[i];
+        if (slot->pos == NOT_FOUND) return NOT_FOUND;
+        if (slot->id == id) return slot->pos;
+    }
+}
+
+// Rebuilds the table with `nslots` (a power of two) slots
+static int index_rehash(IdIndex *index, size_t nslots) {
+    IndexSlot *slots = malloc(nslots * sizeof(IndexSlot));
+    if (slots == NULL) return 0;
+    for (size_t i = 0; i < nslots; i++) slots[i].pos = NOT_FOUND;
+
+    IdIndex grown = {slots, nslots - 1, 64, index->used};
+    while (((size_t)1 << (64 - grown.shift)) < nslots) grown.shift--;
+
+    for (size_t i = 0; index->slots != NULL && i <= index->mask; i++) {
+        if (index->slots[i].pos == NOT_FOUND) continue;
+        size_t j = index_home(&grown, index->slots[i].id);
+        while (slots[j].pos != NOT_FOUND) j = (j + 1) & grown.mask;
+        slots[j] = index->slots[i];
+    }
+    free(index->slots);
+    *index = grown;
+    return 1;
+}
+
+int index_reserve(IdIndex *index, size_t n) {
+    size_t nslots = 2 * INITIAL_CAPACITY;
+    while (nslots < 2 * n) nslots *= 2;
+    if (index->slots != NULL && nslots <= index->mask + 1) return 1;
+    return index_rehash(index, nslots);
+}
+
+// Adds an id that is not yet present. Returns 0 if out of memory.
+int index_insert(IdIndex *index, int id, size_t pos) {
+    // Keep the load factor at or below 1/2
+    if (index->slots == NULL || 2 * (index->used + 1) > index->mask + 1) {
+        size_t nslots = index->slots == NULL ? 2 * INITIAL_CAPACITY : 2 * (index->mask + 1);
+        if (!index_rehash(index, nslots)) return 0;
+    }
+    size_t i = index_home(index, id);
+    while (index->slots[i].pos != NOT_FOUND) i = (i + 1) & index->mask;
+    index->slots[i].id = id;
+    index->slots[i].pos = pos;
+    index->used++;
+    return 1;
+}
+
+// Re-points an existing id at a new store position
+void index_set(IdIndex *index, int id, size_t pos) {
+    size_t i = index_home(index, id);
+    while (index->slots[i].id != id || index->slots[i].pos == NOT_FOUND)
+        i = (i + 1) & index->mask;
+    index->slots[i].pos = pos;
+}
+
+void index_remove(IdIndex *index, int id) {
+    size_t i = index_home(index, id);
+    while (index->slots[i].id != id || index->slots[i].pos == NOT_FOUND)
+        i = (i + 1) & index->mask;
+
+    // Backward-shift deletion: pull later entries of the probe run into the
+    // hole unless that would move them in front of their home slot
+    for (size_t j = (i + 1) & index->mask; index->slots[j].pos != NOT_FOUND;
+         j = (j + 1) & index->mask) {
+        size_t home = index_home(index, index->slots[j].id);
+        if (((j - home) & index->mask) >= ((j - i) & index->mask)) {
+            index->slots[i] = index->slots[j];
+            i = j;
+        }
+    }
+    index->slots[i].pos = NOT_FOUND;
+    index->used--;
+}
+
+// --- RECORD I/O ---
+
+uint64_t checksum_bytes(const void *data, size_t len) {
+    const unsigned char *p = data;
+    const uint64_t prime = 0x100000001B3ull;
+    // Four independent multiply-xor lanes over 8-byte words keep the
+    // multiplier busy; the tail is folded in byte by byte.
+    uint64_t h[4] = {0xCBF29CE484222325ull, 1, 2, 3};
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        for (int k = 0; k < 4; k++) {
+            uint64_t w;
+            memcpy(&w, p + i + 8 * k, 8);
+            h[k] = (h[k] ^ w) * prime;
+        }
+    }
+    uint64_t sum = h[0] ^ (h[1] << 1) ^ (h[2] << 2) ^ (h[3] << 3);
+    for (; i < len; i++) sum = (sum ^ p[i]) * prime;
+    return sum ^ (uint64_t)len;
+}
+
+// Combines the checksums of the four column sections of a data file
+static uint64_t columns_checksum(const int *ids, const float *gpas, const uint32_t *offs,
+                                 size_t count, const char *names, size_t names_len) {
+    uint64_t a = checksum_bytes(ids, count * sizeof(int));
+    uint64_t b = checksum_bytes(gpas, count * sizeof(float));
+    uint64_t c = checksum_bytes(offs, count * sizeof(uint32_t));
+    uint64_t d = checksum_bytes(names, names_len);
+    return a ^ (b << 1 | b >> 63) ^ (c << 2 | c >> 62) ^ (d << 3 | d >> 61);
+}
+
+// Builds the id index over records already in the columns
+static int index_columns(StudentStore *store, const char *path) {
+    if (!index_reserve(&store->index, store->count)) {
+        fprintf(stderr, "Out of memory indexing %s\n", path);
+        return -1;
+    }
+    for (size_t i = 0; i < store->count; i++) {
+        if (index_find(&store->index, store->ids[i]) != NOT_FOUND) {
+            fprintf(stderr, "%s: duplicate ID %d\n", path, store->ids[i]);
+            return -1;
+        }
+        index_insert(&store->index, store->ids[i], i);
+    }
+    return 0;
+}
+
+// Converts a version 1 file (fixed-width Student records) into the store
+static int load_v1(StudentStore *store, const char *path, const void *map, size_t size) {
+    FileHeaderV1 hdr;
+    memcpy(&hdr, map, sizeof(hdr));
+    const StudentV1 *recs = (const StudentV1 *)((const char *)map + sizeof(hdr));
+
+    if (hdr.record_size != sizeof(StudentV1) ||
+        (size - sizeof(hdr)) % sizeof(StudentV1) != 0 ||
+        hdr.count != (size - sizeof(hdr)) / sizeof(StudentV1) ||
+        checksum_bytes(recs, (size_t)hdr.count * sizeof(StudentV1)) != hdr.checksum) {
+        fprintf(stderr, "%s: corrupt version 1 data file\n", path);
+        return -1;
+    }
+    if (!store_reserve(store, (size_t)hdr.count) || !index_reserve(&store->index, (size_t)hdr.count)) {
+        fprintf(stderr, "Out of memory loading %s\n", path);
+        return -1;
+    }
+    for (size_t i = 0; i < hdr.count; i++) {
+        char name[V1_NAME_LEN];
+        memcpy(name, recs[i].name, V1_NAME_LEN);
+        name[V1_NAME_LEN - 1] = '\0';
+        Student s = {name, recs[i].id, recs[i].gpa};
+        if (store_add(store, &s) <= 0) {
+            fprintf(stderr, "%s: duplicate ID %d or out of memory\n", path, s.id);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Map DATA_FILE, validate it and use its columns in place
+int load_students(StudentStore *store, const char *path) {
+    struct stat st;
+    FileHeader hdr;
+    char *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
         // If the file doesn't exist yet, it's not an error.
-        // Just return 0 to indicate no records were loaded.
         return 0;
     }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FileHeader)) {
+        fprintf(stderr, "%s: too short to be a student data file\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
 
-    // Read student records from the file until EOF (End Of File) is reached
-    // Assuming records are stored as "name id gpa" separated by newlines
-    while (records_loaded < MAX_STUDENTS &&
-           fscanf(fp, "%s %d %f",
-                  arr[records_loaded].name,
-                  &arr[records_loaded].id,
-                  &arr[records_loaded].gpa) == 3) {
-        records_loaded++;
+    // Private writable mapping: in-place updates never reach the file
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("Error mapping data file");
+        return -1;
     }
+    memcpy(&hdr, map, sizeof(hdr));
 
-    // Close the file
-    fclose(fp);
+    if (memcmp(hdr.magic, FILE_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s: not a student data file\n", path);
+        munmap(map, size);
+        return -1;
+    }
+    if (hdr.version == 1) {
+        int status = load_v1(store, path, map, size);
+        munmap(map, size);
+        return status;
+    }
+
+    // Section layout: ids, gpas, name offsets (4 bytes per record each),
+    // then the name heap
+    size_t body = size - sizeof(FileHeader);
+    const char *problem = NULL;
+    if (hdr.version != FILE_VERSION)
+        problem = "unsupported format version";
+    else if (hdr.count > body / 12 || hdr.names_len != body - 12 * hdr.count)
+        problem = "file size does not match record count";
+    int *ids = (int *)(map + sizeof(FileHeader));
+    float *gpas = (float *)(ids + hdr.count);
+    uint32_t *offs = (uint32_t *)(gpas + hdr.count);
+    char *names = (char *)(offs + hdr.count);
+    if (problem == NULL &&
+        columns_checksum(ids, gpas, offs, (size_t)hdr.count, names, (size_t)hdr.names_len) != hdr.checksum)
+        problem = "checksum mismatch";
+    if (problem == NULL && hdr.names_len > 0 && names[hdr.names_len - 1] != '\0')
+        problem = "unterminated name";
+    for (size_t i = 0; problem == NULL && i < hdr.count; i++)
+        if (offs[i] >= hdr.names_len) problem = "name offset out of range";
+    if (problem != NULL) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        munmap(map, size);
+        return -1;
+    }
+
+    store->map = map;
+    store->map_len = size;
+    store->ids = ids;
+    store->gpas = gpas;
+    store->name_offs = offs;
+    arena_attach(&store->names, names, (size_t)hdr.names_len);
+    store->count = store->capacity = (size_t)hdr.count;
+    store->names_dead = 0;
 
-    return records_loaded;
+    // Only the id index is built; the columns themselves are used in place
+    return index_columns(store, path);
 }
 
 
 
-// Write all students to DATA_FILE
-void save_students(Student arr[], int count) {
+// Flushes the directory holding `path`, so a rename into it survives a
+// crash. Returns 0 on success.
+static int sync_parent(const char *path) {
+    char dir[4096];
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else {
+        size_t len = slash == path ? 1 : (size_t)(slash - path);
+        if (len >= sizeof(dir)) return -1;
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+    }
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return -1;
+    int err = fsync(fd);
+    close(fd);
+    return err;
+}
+
+// Write header and columns to a temporary file, then rename it over `path`
+// so a crash mid-save leaves the previous file intact
+int save_students(const StudentStore *store, const char *path) {
+    char tmp[4096];
+    FileHeader hdr;
     FILE *fp;
-    int i;
+    size_t n = store->count;
 
-    // Open the file for writing ("w"). This creates the file if it doesn't exist
-    // or truncates (clears) the file if it does exist.
-    fp = fopen(DATA_FILE, "w");
+    memcpy(hdr.magic, FILE_MAGIC, 4);
+    hdr.version = FILE_VERSION;
+    hdr.count = n;
+    hdr.names_len = store->names.len;
+    hdr.checksum = columns_checksum(store->ids, store->gpas, store->name_offs, n,
+                                    store->names.data, store->names.len);
 
-    // Check if the file opened successfully
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fp = fopen(tmp, "wb");
     if (fp == NULL) {
         perror("Error opening file for saving");
-        return;
+        return -1;
+    }
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+             fwrite(store->ids, sizeof(int), n, fp) == n &&
+             fwrite(store->gpas, sizeof(float), n, fp) == n &&
+             fwrite(store->name_offs, sizeof(uint32_t), n, fp) == n &&
+             fwrite(store->names.data, 1, store->names.len, fp) == store->names.len &&
+             fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        perror("Error saving data file");
+        remove(tmp);
+        return -1;
     }
+    if (sync_parent(path) != 0) {
+        perror("Error saving data file");
+        return -1;
+    }
+    return 0;
+}
 
-    // Write each student record to the file
-    for (i = 0; i < count; i++) {
-        // Write as: name id gpa\n
-        fprintf(fp, "%s %d %.2f\n",
-                arr[i].name,
-                arr[i].id,
-                arr[i].gpa);
+
+
+// Parses a whole string as an id; returns 0 if malformed
+static int parse_id(const char *text, int *id) {
+    char *rest;
+    long value = strtol(text, &rest, 10);
+    if (*text == '\0' || *rest != '\0' || value < INT_MIN || value > INT_MAX) return 0;
+    *id = (int)value;
+    return 1;
+}
+
+// Parses a whole string as a GPA; returns 0 if malformed
+static int parse_gpa(const char *text, float *gpa) {
+    // Fast path for plain decimals of up to 7 digits, such as "3.75": the
+    // digits and the power of ten are exact floats, so one division rounds
+    // the same way strtof does
+    const char *p = text + (*text == '-');
+    uint32_t digits = 0, scale = 1;
+    int count = 0, point = 0;
+    for (; count <= 7; p++) {
+        if (*p >= '0' && *p <= '9') {
+            digits = digits * 10 + (uint32_t)(*p - '0');
+            if (point) scale *= 10;
+            count++;
+        } else if (*p == '.' && !point) {
+            point = 1;
+        } else {
+            break;
+        }
+    }
+    if (*p == '\0' && count > 0 && count <= 7) {
+        *gpa = (float)digits / (float)scale;
+        if (*text == '-') *gpa = -*gpa;
+        return 1;
     }
 
-    // Close the file
-    fclose(fp);
+    char *rest;
+    *gpa = strtof(text, &rest);
+    return *text != '\0' && *rest == '\0';
 }
 
+// Splits a "name id gpa" line in place. The id and GPA are the last two
+// words, so the name itself may contain spaces. Returns 0 if malformed.
+int parse_record(char *line, Student *out) {
+    char *end = line + strlen(line);
+    char *field[2];
 
+    // Peel the GPA and then the id off the end of the line
+    for (int k = 1; k >= 0; k--) {
+        while (end > line && isspace((unsigned char)end[-1])) end--;
+        *end = '\0';
+        while (end > line && !isspace((unsigned char)end[-1])) end--;
+        field[k] = end;
+    }
+    while (end > line && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    while (isspace((unsigned char)*line)) line++;
 
-// Read input from user and append to array
-void add_student(Student arr[], int *count) {
-    // Check for array overflow
-    if (*count >= MAX_STUDENTS) {
-        printf("\n** ERROR: Student array is full. Cannot add more students. **\n");
-        return;
+    if (!parse_id(field[0], &out->id) || !parse_gpa(field[1], &out->gpa) || *line == '\0')
+        return 0;
+    out->name = line;
+    return 1;
+}
+
+
+int split_fields(char *line, char delim, char **field, int max) {
+    char *p = line;
+    int n = 0;
+
+    for (;;) {
+        // Surrounding blanks are not part of a field
+        while (*p != delim && isspace((unsigned char)*p)) p++;
+        char *start = p;
+        char *out;
+        if (*p == '"') {
+            // Copy the quoted text down over the opening quote, unescaping ""
+            out = p++;
+            while (*p != '\0') {
+                if (*p == '"' && *++p != '"') break;
+                *out++ = *p++;
+            }
+            while (*p != '\0' && *p != delim) p++;
+        } else {
+            while (*p != '\0' && *p != delim) p++;
+            out = p;
+            while (out > start && isspace((unsigned char)out[-1])) out--;
+        }
+        char next = *p;
+        *out = '\0';
+        if (n < max) field[n] = start;
+        n++;
+        if (next == '\0') return n;
+        p++;
     }
+}
 
-    printf("\n--- Add New Student ---\n");
 
-    // Get Name
-    printf("Enter Name (one word): ");
-    // Use %s to read a single word.
-    // Use an explicit width limit to prevent buffer overflow.
-    scanf("%49s", arr[*count].name);
+// Buffered line reader for import: reads the file in IMPORT_CHUNK pieces
+// and hands out lines in place, so no per-line allocation or copying
+typedef struct {
+    FILE *fp;
+    char *buf;
+    size_t start, len, cap;   // unread bytes are buf[start, len)
+    int eof;
+} LineReader;
 
-    // Get ID
-    printf("Enter ID: ");
-    while (scanf("%d", &arr[*count].id) != 1) {
-        printf("Invalid input. Please enter an integer for ID: ");
-        while (getchar() != '\n');
+// Returns the next line without its line ending, or NULL at the end of the
+// input (or if out of memory, with `eof` left 0). The line stays valid
+// until the next call.
+static char *next_line(LineReader *r) {
+    for (;;) {
+        char *line = r->buf + r->start;
+        char *nl = memchr(line, '\n', r->len - r->start);
+        if (nl != NULL || (r->eof && r->start < r->len)) {
+            char *end = nl != NULL ? nl : r->buf + r->len;
+            r->start = (size_t)(end - r->buf) + (nl != NULL);
+            if (end > line && end[-1] == '\r') end--;
+            *end = '\0';
+            return line;
+        }
+        if (r->eof) return NULL;
+
+        // Keep the partial line and read more after it, one byte short of
+        // the end so a last line without a newline can be terminated
+        memmove(r->buf, line, r->len - r->start);
+        r->len -= r->start;
+        r->start = 0;
+        if (r->cap - r->len <= IMPORT_CHUNK / 2) {
+            char *buf = realloc(r->buf, 2 * r->cap);
+            if (buf == NULL) return NULL;
+            r->buf = buf;
+            r->cap *= 2;
+        }
+        size_t got = fread(r->buf + r->len, 1, r->cap - r->len - 1, r->fp);
+        r->len += got;
+        if (got == 0) r->eof = 1;
     }
-    // Clear newline character from buffer
-    while (getchar() != '\n');
+}
 
-    // Get GPA
-    printf("Enter GPA: ");
-    while (scanf("%f", &arr[*count].gpa) != 1 || arr[*count].gpa < 0.0 || arr[*count].gpa > 4.0) {
-        printf("Invalid input. Please enter a GPA between 0.0 and 4.0: ");
-        while (getchar() != '\n');
+// Finds the name, id and gpa columns in a CSV/TSV header line. Returns 0,
+// leaving `col` alone, if the line is not a header naming all three.
+static int header_columns(char **field, int n, int col[3]) {
+    static const char *const names[3] = {"name", "id", "gpa"};
+    int found[3];
+
+    if (n > MAX_FIELDS) n = MAX_FIELDS;
+    for (int k = 0; k < 3; k++) {
+        found[k] = -1;
+        for (int i = 0; i < n && found[k] < 0; i++) {
+            const char *a = field[i], *b = names[k];
+            while (*a != '\0' && tolower((unsigned char)*a) == *b) a++, b++;
+            if (*a == '\0' && *b == '\0') found[k] = i;
+        }
+        if (found[k] < 0) return 0;
     }
-    // Clear newline character from buffer
-    while (getchar() != '\n');
+    memcpy(col, found, sizeof(found));
+    return 1;
+}
 
-    // Increment the count of students
-    (*count)++;
+RecordFormat format_of(const char *path) {
+    const char *dot = strrchr(path, '.');
 
-    printf("Student record added successfully!\n\n");
+    if (dot != NULL && (strcmp(dot, ".csv") == 0 || strcmp(dot, ".CSV") == 0)) return FORMAT_CSV;
+    if (dot != NULL && (strcmp(dot, ".tsv") == 0 || strcmp(dot, ".TSV") == 0)) return FORMAT_TSV;
+    return FORMAT_TEXT;
 }
 
 
-// Print all student records
-void list_students(Student arr[], int count) {
-    int i;
+// Streaming parser for the import formats, shared by import and sort
+typedef struct {
+    LineReader lines;
+    const char *path;
+    RecordFormat format;
+    // Positions of the name, id and gpa columns; a header line may move them
+    int col[3];
+    int first;
+    size_t malformed;
+} RecordReader;
 
-    printf("\n--- Student List (%d Records) ---\n", count);
+// Opens `path` ("-" is stdin); returns 0 on success, -1 on error
+static int reader_open(RecordReader *r, const char *path, RecordFormat format) {
+    memset(r, 0, sizeof(*r));
+    r->path = path;
+    r->format = format;
+    r->col[0] = 0;
+    r->col[1] = 1;
+    r->col[2] = 2;
+    r->first = 1;
 
-    if (count == 0) {
-        printf("No students currently in the system.\n");
-        printf("---------------------------------\n\n");
-        return;
+    // Open the file for reading ("r")
+    r->lines.fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+
+    // Check if the file opened successfully
+    if (r->lines.fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    r->lines.cap = IMPORT_CHUNK;
+    r->lines.buf = malloc(r->lines.cap);
+    if (r->lines.buf == NULL) {
+        if (r->lines.fp != stdin) fclose(r->lines.fp);
+        return -1;
     }
+    return 0;
+}
 
-    // Print Header
-    printf("%-5s | %-20s | %s\n", "ID", "Name", "GPA");
-    printf("----------------------------------------\n");
+// Reads the next well-formed record. Returns 1 and fills `out` (its name
+// stays valid until the next call), 0 at the end of the input, or -1 on a
+// read error or if out of memory.
+static int reader_next(RecordReader *r, Student *out) {
+    char delim = r->format == FORMAT_TSV ? '\t' : ',';
+    char *field[MAX_FIELDS];
+    char *line;
 
-    // Print each student record
-    for (i = 0; i < count; i++) {
-        printf("%-5d | %-20s | %.2f\n",
-               arr[i].id,
-               arr[i].name,
-               arr[i].gpa);
-    }
+    while ((line = next_line(&r->lines)) != NULL) {
+        // Blank lines are skipped silently
+        if (line[strspn(line, " \t\r")] == '\0') continue;
 
-    printf("----------------------------------------\n\n");
-}
\ No newline at end of file
+        int ok;
+        if (r->format == FORMAT_TEXT) {
+            ok = parse_record(line, out);
+        } else {
+            int n = split_fields(line, delim, field, MAX_FIELDS);
+            if (r->first && header_columns(field, n, r->col)) {
+                r->first = 0;
+                continue;
+            }
+            if (n > MAX_FIELDS) n = MAX_FIELDS;
+            const int *col = r->col;
+            ok = col[0] < n && col[1] < n && col[2] < n && *field[col[0]] != '\0' &&
+                 parse_id(field[col[1]], &out->id) && parse_gpa(field[col[2]], &out->gpa);
+            out->name = field[col[0]];
+        }
+        r->first = 0;
+        if (ok) return 1;
+        r->malformed++;
+    }
+    return r->lines.eof && !ferror(r->lines.fp) ? 0 : -1;
+}
+
+// Reports skipped lines and closes the input
+static void reader_close(RecordReader *r) {
+    if (r->malformed > 0)
+        fprintf(stderr, "Skipped %zu malformed line(s) in %s.\n", r->malformed, r->path);
+    free(r->lines.buf);
+    // Close the file
+    if (r->lines.fp != stdin) fclose(r->lines.fp);
+}
+
+
+// Reads `path` and hands each record to `add`, which returns 1 if it was
+// added, 0 if its id already exists and -1 if out of memory. Returns the
+// number added, or -1 on error.
+static long import_each(const char *path, RecordFormat format,
+                        int (*add)(void *ctx, const Student *rec), void *ctx) {
+    RecordReader reader;
+    Student s;
+    long records_loaded = 0;
+    size_t duplicates = 0;
+    int added = 1;
+    int got;
+
+    if (reader_open(&reader, path, format) != 0)
+        return -1;
+
+    while ((got = reader_next(&reader, &s)) == 1) {
+        added = add(ctx, &s);
+        if (added < 0) break;
+        if (added == 0) duplicates++;
+        else records_loaded++;
+    }
+    if (duplicates > 0)
+        fprintf(stderr, "Skipped %zu record(s) with duplicate IDs in %s.\n", duplicates, path);
+    if (added < 0 || got < 0)
+        fprintf(stderr, "%s after %ld record(s); the rest of %s was not loaded.\n",
+                added < 0 || !ferror(reader.lines.fp) ? "Out of memory" : "Read error",
+                records_loaded, path);
+    reader_close(&reader);
+    return got < 0 ? -1 : records_loaded;
+}
+
+static int import_add(void *store, const Student *rec) {
+    return store_add(store, rec);
+}
+
+// Open a text, CSV or TSV file and add its records until EOF
+long import_records(StudentStore *store, const char *path, RecordFormat format) {
+    long added = import_each(path, format, import_add, store);
+    // Give back the growth slack now that the size is known
+    store_shrink(store);
+    return added;
+}
+
+
+// Write one CSV/TSV field, quoting it if it would not read back as is
+static void write_field(FILE *fp, const char *text, char delim) {
+    size_t n = strlen(text);
+    int quote = n == 0 || isspace((unsigned char)text[0]) || isspace((unsigned char)text[n - 1]) ||
+                strchr(text, delim) != NULL || strchr(text, '"') != NULL;
+
+    if (!quote) {
+        fputs(text, fp);
+        return;
+    }
+    putc('"', fp);
+    for (; *text != '\0'; text++) {
+        if (*text == '"') putc('"', fp);
+        putc(*text, fp);
+    }
+    putc('"', fp);
+}
+
+// Opens an output file ("-" is stdout) and writes the header its format
+// needs; returns NULL on error
+static FILE *writer_open(const char *path, RecordFormat format) {
+    char delim = format == FORMAT_TSV ? '\t' : ',';
+
+    // Open the file for writing ("w"). This creates the file if it doesn't exist
+    // or truncates (clears) the file if it does exist.
+    FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+
+    // Check if the file opened successfully
+    if (fp == NULL) {
+        perror(path);
+        return NULL;
+    }
+    if (fp != stdout) setvbuf(fp, NULL, _IOFBF, IMPORT_CHUNK);
+    if (format != FORMAT_TEXT)
+        fprintf(fp, "name%cid%cgpa\n", delim, delim);
+    return fp;
+}
+
+// Writes one record in the given format
+static void write_record(FILE *fp, RecordFormat format, const Student *rec) {
+    char delim = format == FORMAT_TSV ? '\t' : ',';
+
+    if (format == FORMAT_TEXT) {
+        // Write as: name id gpa\n
+        fprintf(fp, "%s %d %.2f\n", rec->name, rec->id, rec->gpa);
+        return;
+    }
+    write_field(fp, rec->name, delim);
+    fprintf(fp, "%c%d%c%.2f\n", delim, rec->id, delim, rec->gpa);
+}
+
+// Flushes and closes an output file; returns 0 if everything was written
+static int writer_close(FILE *fp) {
+    if (fp == stdout ? fflush(fp) != 0 || ferror(fp) : fclose(fp) != 0) {
+        perror("Error writing output file");
+        return -1;
+    }
+    return 0;
+}
+
+
+// Write all students to a file in the given format
+int export_records(const StudentStore *store, const char *path, RecordFormat format) {
+    FILE *fp = writer_open(path, format);
+    Student rec;
+
+    if (fp == NULL)
+        return -1;
+
+    // Write each student record to the file
+    for (size_t i = 0; i < store->count; i++) {
+        store_get(store, i, &rec);
+        write_record(fp, format, &rec);
+    }
+
+    return writer_close(fp);
+}
+
+
+// --- EXTERNAL SORT ---
+
+// Fixed part of a record in a sort run file; the name and its NUL follow
+typedef struct {
+    int32_t id;
+    float gpa;
+    uint32_t name_len;
+} RunRecord;
+
+// A sorted run: a byte range of a temporary file
+typedef struct {
+    off_t start, end;
+} Run;
+
+// Reads one run back in large sequential blocks
+typedef struct {
+    int fd;
+    off_t pos, end;          // part of the run not yet read into `buf`
+    char *buf;
+    size_t at, len, cap;     // unconsumed bytes are buf[at, len)
+    Student rec;             // current record; its name points into `buf`
+} RunCursor;
+
+// Where sorted records go: a run file or the final output
+typedef struct {
+    FILE *fp;
+    RecordFormat format;
+    int run;                 // write RunRecords instead of `format`
+    off_t written;           // bytes written so far (run files only)
+} SortSink;
+
+typedef int (*RecordCmp)(const void *, const void *);
+
+// Orders records completely, so equal keys come out the same way however
+// the input was split into runs: by `first`, then id, name and GPA
+static int cmp_records(const Student *x, const Student *y, SortKey first) {
+    int c = 0;
+    if (first == SORT_GPA) {
+        uint64_t kx = gpa_key(x->gpa, x->id), ky = gpa_key(y->gpa, y->id);
+        if (kx != ky) return kx < ky ? -1 : 1;
+    }
+    if (first == SORT_NAME && (c = strcmp(x->name, y->name)) != 0) return c;
+    if (x->id != y->id) return x->id < y->id ? -1 : 1;
+    if (first != SORT_NAME && (c = strcmp(x->name, y->name)) != 0) return c;
+    uint64_t kx = gpa_key(x->gpa, 0), ky = gpa_key(y->gpa, 0);
+    return (kx > ky) - (kx < ky);
+}
+
+static int cmp_by_id(const void *a, const void *b) {
+    return cmp_records(a, b, SORT_ID);
+}
+
+// GPA order as in the GPA index (NaN after +inf)
+static int cmp_by_gpa(const void *a, const void *b) {
+    return cmp_records(a, b, SORT_GPA);
+}
+
+static int cmp_by_name(const void *a, const void *b) {
+    return cmp_records(a, b, SORT_NAME);
+}
+
+// Leading part of the sort order as an unsigned integer: the id, the GPA
+// index key, or the first 8 bytes of the name
+static uint64_t sort_prefix(const Student *rec, SortKey key) {
+    if (key == SORT_ID) return (uint32_t)rec->id ^ 0x80000000u;
+    if (key == SORT_GPA) return gpa_key(rec->gpa, rec->id);
+    uint64_t prefix = 0;
+    for (int i = 0; i < 8 && rec->name[i] != '\0'; i++)
+        prefix |= (uint64_t)(unsigned char)rec->name[i] << (56 - 8 * i);
+    return prefix;
+}
+
+// Sorts recs[0, n) using tmp[0, n) as scratch. (prefix, position) pairs
+// are LSD radix sorted in 16-bit passes, skipping passes in which every
+// prefix has the same digit; runs of equal prefixes are then finished with
+// the full comparison. Falls back to qsort if out of memory.
+static void sort_slice(Student *recs, Student *tmp, size_t n, SortKey key, RecordCmp cmp) {
+    uint64_t *keys = malloc(2 * n * sizeof(uint64_t) + 1);
+    uint32_t *pos = malloc(2 * n * sizeof(uint32_t) + 1);
+    size_t *hist = malloc(SORT_HIST_BYTES);
+    if (keys == NULL || pos == NULL || hist == NULL) {
+        free(keys);
+        free(pos);
+        free(hist);
+        qsort(recs, n, sizeof(Student), cmp);
+        return;
+    }
+
+    uint64_t *k0 = keys, *k1 = keys + n;
+    uint32_t *p0 = pos, *p1 = pos + n;
+    for (size_t i = 0; i < n; i++) {
+        k0[i] = sort_prefix(&recs[i], key);
+        p0[i] = (uint32_t)i;
+    }
+    for (int shift = 0; shift < 64 && n > 0; shift += 16) {
+        memset(hist, 0, SORT_HIST_BYTES);
+        for (size_t i = 0; i < n; i++) hist[(k0[i] >> shift) & 0xFFFF]++;
+        if (hist[(k0[0] >> shift) & 0xFFFF] == n) continue;
+        size_t sum = 0;
+        for (size_t b = 0; b < 65536; b++) {
+            size_t count = hist[b];
+            hist[b] = sum;
+            sum += count;
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t to = hist[(k0[i] >> shift) & 0xFFFF]++;
+            k1[to] = k0[i];
+            p1[to] = p0[i];
+        }
+        uint64_t *ks = k0;
+        k0 = k1;
+        k1 = ks;
+        uint32_t *ps = p0;
+        p0 = p1;
+        p1 = ps;
+    }
+
+    for (size_t i = 0; i < n; i++) tmp[i] = recs[p0[i]];
+    for (size_t i = 0, j; i < n; i = j) {
+        for (j = i + 1; j < n && k0[j] == k0[i]; j++) {}
+        if (j - i > 1) qsort(tmp + i, j - i, sizeof(Student), cmp);
+    }
+    memcpy(recs, tmp, n * sizeof(Student));
+    free(keys);
+    free(pos);
+    free(hist);
+}
+
+// Work item for the sort threads: sort `recs[0, n)` with `out` as scratch,
+// or merge it with `other[0, n_other)` into `out`
+typedef struct {
+    Student *recs, *other, *out;
+    size_t n, n_other;
+    int merge;
+    SortKey key;
+    RecordCmp cmp;
+} SortTask;
+
+static void *sort_task(void *arg) {
+    SortTask *t = arg;
+
+    if (!t->merge) {
+        sort_slice(t->recs, t->out, t->n, t->key, t->cmp);
+        return NULL;
+    }
+    size_t i = 0, j = 0, k = 0;
+    while (i < t->n && j < t->n_other)
+        t->out[k++] = t->cmp(&t->other[j], &t->recs[i]) < 0 ? t->other[j++] : t->recs[i++];
+    memcpy(t->out + k, t->recs + i, (t->n - i) * sizeof(Student));
+    // A carried-over slice has no `other`; memcpy from NULL is undefined
+    // even for zero bytes
+    if (t->n_other > j)
+        memcpy(t->out + k + t->n - i, t->other + j, (t->n_other - j) * sizeof(Student));
+    return NULL;
+}
+
+// Runs `count` tasks, one per thread, the first on the calling thread
+static void run_tasks(SortTask *tasks, int count) {
+    pthread_t tid[MAX_SORT_THREADS];
+    int started[MAX_SORT_THREADS] = {0};
+
+    for (int i = 1; i < count; i++)
+        started[i] = pthread_create(&tid[i], NULL, sort_task, &tasks[i]) == 0;
+    sort_task(&tasks[0]);
+    for (int i = 1; i < count; i++) {
+        if (started[i]) pthread_join(tid[i], NULL);
+        else sort_task(&tasks[i]);
+    }
+}
+
+// Sorts recs[0, n) with up to `threads` threads: each sorts one slice, then
+// neighbouring slices are merged pairwise, in parallel, until one is left.
+// `tmp` has room for n records. Returns whichever array holds the result.
+static Student *sort_parallel(Student *recs, Student *tmp, size_t n, int threads, SortKey key,
+                              RecordCmp cmp) {
+    SortTask tasks[MAX_SORT_THREADS];
+    size_t bounds[MAX_SORT_THREADS + 1];
+    int parts = threads;
+
+    // Small runs are not worth the threads
+    while (parts > 1 && n / (size_t)parts < 16384) parts--;
+    for (int i = 0; i <= parts; i++) bounds[i] = n * (size_t)i / (size_t)parts;
+    for (int i = 0; i < parts; i++)
+        tasks[i] = (SortTask){recs + bounds[i], NULL, tmp + bounds[i], bounds[i + 1] - bounds[i], 0,
+                              0, key, cmp};
+    run_tasks(tasks, parts);
+
+    while (parts > 1) {
+        int pairs = parts / 2;
+        for (int i = 0; i < pairs; i++) {
+            size_t a = bounds[2 * i], b = bounds[2 * i + 1], c = bounds[2 * i + 2];
+            tasks[i] = (SortTask){recs + a, recs + b, tmp + a, b - a, c - b, 1, key, cmp};
+        }
+        // An odd slice out is carried over unchanged
+        if (parts % 2 != 0) {
+            size_t a = bounds[parts - 1];
+            tasks[pairs++] = (SortTask){recs + a, NULL, tmp + a, n - a, 0, 1, key, cmp};
+        }
+        run_tasks(tasks, pairs);
+        for (int i = 0; i < pairs; i++) bounds[i] = bounds[2 * i];
+        bounds[pairs] = n;
+        parts = pairs;
+        Student *swap = recs;
+        recs = tmp;
+        tmp = swap;
+    }
+    return recs;
+}
+
+static int sink_write(SortSink *sink, const Student *rec) {
+    if (!sink->run) {
+        write_record(sink->fp, sink->format, rec);
+        return 0;
+    }
+    RunRecord r = {rec->id, rec->gpa, (uint32_t)strlen(rec->name)};
+    if (fwrite(&r, sizeof(r), 1, sink->fp) != 1 ||
+        fwrite(rec->name, 1, r.name_len + 1, sink->fp) != r.name_len + 1)
+        return -1;
+    sink->written += (off_t)(sizeof(r) + r.name_len + 1);
+    return 0;
+}
+
+// Loads the next record of the run into cursor->rec. Returns 1, 0 at the
+// end of the run, or -1 on a read error or if out of memory.
+static int cursor_next(RunCursor *c) {
+    RunRecord r;
+    size_t need = sizeof(r);
+
+    for (int pass = 0; pass < 2; pass++) {
+        while (c->len - c->at < need) {
+            if (c->pos >= c->end) return c->at == c->len ? 0 : -1;
+            // Refill: keep the partial record and read a large block after it
+            memmove(c->buf, c->buf + c->at, c->len - c->at);
+            c->len -= c->at;
+            c->at = 0;
+            if (c->cap < need) {
+                char *buf = realloc(c->buf, need);
+                if (buf == NULL) return -1;
+                c->buf = buf;
+                c->cap = need;
+            }
+            size_t want = c->cap - c->len;
+            if ((off_t)want > c->end - c->pos) want = (size_t)(c->end - c->pos);
+            ssize_t got = pread(c->fd, c->buf + c->len, want, c->pos);
+            if (got <= 0) return -1;
+            c->len += (size_t)got;
+            c->pos += got;
+        }
+        memcpy(&r, c->buf + c->at, sizeof(r));
+        need = sizeof(r) + r.name_len + 1;
+    }
+    c->rec.id = r.id;
+    c->rec.gpa = r.gpa;
+    c->rec.name = c->buf + c->at + sizeof(r);
+    c->at += need;
+    return 1;
+}
+
+// Restores the heap property below heap[i]; heap entries index `cursors`
+static void heap_down(size_t *heap, size_t n, size_t i, const RunCursor *cursors, RecordCmp cmp) {
+    for (;;) {
+        size_t least = i, l = 2 * i + 1, r = l + 1;
+        if (l < n && cmp(&cursors[heap[l]].rec, &cursors[heap[least]].rec) < 0) least = l;
+        if (r < n && cmp(&cursors[heap[r]].rec, &cursors[heap[least]].rec) < 0) least = r;
+        if (least == i) return;
+        size_t swap = heap[i];
+        heap[i] = heap[least];
+        heap[least] = swap;
+        i = least;
+    }
+}
+
+// Merges `k` runs of the file `fd` into `sink`, giving each run a read
+// buffer of `buf_size` bytes. Returns 0 on success.
+static int merge_runs(int fd, const Run *runs, size_t k, size_t buf_size, RecordCmp cmp,
+                      SortSink *sink) {
+    RunCursor *cursors = calloc(k, sizeof(RunCursor));
+    size_t *heap = malloc(k * sizeof(size_t));
+    size_t n = 0;
+    int status = cursors != NULL && heap != NULL ? 0 : -1;
+
+    for (size_t i = 0; i < k && status == 0; i++) {
+        cursors[i] = (RunCursor){fd, runs[i].start, runs[i].end, malloc(buf_size), 0, 0, buf_size,
+                                 {NULL, 0, 0.0f}};
+        int got = cursors[i].buf != NULL ? cursor_next(&cursors[i]) : -1;
+        if (got < 0) status = -1;
+        else if (got > 0) heap[n++] = i;
+    }
+    for (size_t i = n / 2; i-- > 0;) heap_down(heap, n, i, cursors, cmp);
+
+    // Repeatedly emit the smallest current record and advance its run
+    while (n > 0 && status == 0) {
+        RunCursor *c = &cursors[heap[0]];
+        if (sink_write(sink, &c->rec) != 0) {
+            status = -1;
+            break;
+        }
+        int got = cursor_next(c);
+        if (got < 0) status = -1;
+        else if (got == 0) heap[0] = heap[--n];
+        heap_down(heap, n, 0, cursors, cmp);
+    }
+
+    for (size_t i = 0; cursors != NULL && i < k; i++) free(cursors[i].buf);
+    free(cursors);
+    free(heap);
+    return status;
+}
+
+// Read buffer per run when merging `k` runs: an equal share of the budget
+// (one share is left for the output), but at least SORT_MIN_BUF
+static size_t merge_buffer(size_t budget, size_t k) {
+    size_t size = budget / (k + 1);
+    return size < SORT_MIN_BUF ? SORT_MIN_BUF : size;
+}
+
+// Creates an anonymous temporary file next to `out`; returns a stream open
+// for reading and writing, or NULL
+static FILE *sort_tmpfile(const char *out, int n) {
+    char path[4096];
+
+    snprintf(path, sizeof(path), "%s.sort%d", strcmp(out, "-") == 0 ? "students" : out, n);
+    FILE *fp = fopen(path, "w+b");
+    if (fp == NULL) {
+        perror(path);
+        return NULL;
+    }
+    // Unlinked right away, so nothing is left behind even after a crash
+    remove(path);
+    setvbuf(fp, NULL, _IOFBF, SORT_MIN_BUF);
+    return fp;
+}
+
+long sort_records(const char *in, RecordFormat in_format, const char *out, RecordFormat out_format,
+                  SortKey key, size_t budget, int threads) {
+    RecordCmp cmp = key == SORT_ID ? cmp_by_id : key == SORT_GPA ? cmp_by_gpa : cmp_by_name;
+    RecordReader reader;
+    Student rec;
+    FILE *tmp[2] = {NULL, NULL};
+    FILE *fp = NULL;
+    Run *runs = NULL;
+    size_t nruns = 0, runs_cap = 0;
+    long total = 0;
+    int status = -1;
+    int got;
+
+    if (threads < 1) threads = 1;
+    if (threads > MAX_SORT_THREADS) threads = MAX_SORT_THREADS;
+    if (budget < 4 * SORT_MIN_BUF) budget = 4 * SORT_MIN_BUF;
+    // Every sorting thread also holds a radix histogram: keep those to a
+    // quarter of the budget, using fewer threads if need be, and leave the
+    // rest for the runs
+    while (threads > 1 && (size_t)threads * SORT_HIST_BYTES > budget / 4) threads--;
+    budget -= (size_t)threads * SORT_HIST_BYTES;
+
+    // Half of the budget holds names, the other half two record arrays
+    // (the second is scratch for sort_parallel) plus the radix sort's keys
+    size_t names_cap = budget / 2;
+    size_t max_recs = budget / 2 / (2 * sizeof(Student) + 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t));
+    char *names = malloc(names_cap);
+    Student *recs = malloc(max_recs * sizeof(Student));
+    Student *spare = malloc(max_recs * sizeof(Student));
+    if (names == NULL || recs == NULL || spare == NULL || reader_open(&reader, in, in_format) != 0) {
+        free(names);
+        free(recs);
+        free(spare);
+        return -1;
+    }
+
+    // Phase 1: cut the input into runs that fit the budget, sort each one
+    // in parallel and write it out sequentially
+    got = reader_next(&reader, &rec);
+    while (got == 1) {
+        size_t n = 0, used = 0;
+        while (got == 1 && n < max_recs) {
+            size_t len = strlen(rec.name) + 1;
+            if (used + len > names_cap) break;
+            memcpy(names + used, rec.name, len);
+            recs[n] = rec;
+            recs[n++].name = names + used;
+            used += len;
+            got = reader_next(&reader, &rec);
+        }
+        if (n == 0) {
+            fprintf(stderr, "A name in %s is larger than the memory budget.\n", in);
+            goto done;
+        }
+        Student *sorted = sort_parallel(recs, spare, n, threads, key, cmp);
+
+        // Everything fit into one run: it is the result
+        if (got == 0 && nruns == 0) {
+            fp = writer_open(out, out_format);
+            if (fp == NULL) goto done;
+            SortSink sink = {fp, out_format, 0, 0};
+            for (size_t i = 0; i < n; i++) sink_write(&sink, &sorted[i]);
+            total = (long)n;
+            status = 0;
+            goto done;
+        }
+
+        if (tmp[0] == NULL && (tmp[0] = sort_tmpfile(out, 0)) == NULL) goto done;
+        if (nruns == runs_cap) {
+            size_t cap = runs_cap ? 2 * runs_cap : 64;
+            Run *grown = realloc(runs, cap * sizeof(Run));
+            if (grown == NULL) goto done;
+            runs = grown;
+            runs_cap = cap;
+        }
+        SortSink sink = {tmp[0], out_format, 1, 0};
+        off_t start = nruns > 0 ? runs[nruns - 1].end : 0;
+        for (size_t i = 0; i < n; i++)
+            if (sink_write(&sink, &sorted[i]) != 0) goto done;
+        runs[nruns].start = start;
+        runs[nruns++].end = start + sink.written;
+        total += (long)n;
+    }
+    if (got < 0) goto done;
+
+    // The run buffers are not needed any more; the budget goes to reading
+    free(names);
+    free(recs);
+    free(spare);
+    names = NULL;
+    recs = spare = NULL;
+    if (tmp[0] != NULL && fflush(tmp[0]) != 0) goto done;
+
+    // Phase 2: merge at most `fanin` runs at a time, in passes that
+    // alternate between the two temporary files, until one merge is left.
+    // Each input and the output need SORT_MIN_BUF, so that many fit.
+    size_t fanin = budget / SORT_MIN_BUF - 1;
+    if (fanin < 2) fanin = 2;
+    int src = 0;
+    while (nruns > fanin) {
+        if (tmp[1 - src] == NULL && (tmp[1 - src] = sort_tmpfile(out, 1)) == NULL) goto done;
+        FILE *dst = tmp[1 - src];
+        if (fflush(dst) != 0 || ftruncate(fileno(dst), 0) != 0) goto done;
+        rewind(dst);
+        SortSink sink = {dst, out_format, 1, 0};
+        size_t merged = 0;
+        for (size_t i = 0; i < nruns; i += fanin) {
+            size_t k = nruns - i < fanin ? nruns - i : fanin;
+            off_t start = sink.written;
+            if (merge_runs(fileno(tmp[src]), runs + i, k, merge_buffer(budget, k), cmp, &sink) != 0 ||
+                fflush(dst) != 0)
+                goto done;
+            runs[merged].start = start;
+            runs[merged++].end = sink.written;
+        }
+        nruns = merged;
+        src = 1 - src;
+    }
+
+    fp = writer_open(out, out_format);
+    if (fp == NULL) goto done;
+    SortSink sink = {fp, out_format, 0, 0};
+    if (nruns > 0 &&
+        merge_runs(fileno(tmp[src]), runs, nruns, merge_buffer(budget, nruns), cmp, &sink) != 0)
+        goto done;
+    status = 0;
+
+done:
+    if (got < 0)
+        fprintf(stderr, "Error reading %s.\n", in);
+    else if (status != 0)
+        perror("Error sorting");
+    reader_close(&reader);
+    if (fp != NULL && writer_close(fp) != 0) status = -1;
+    for (int i = 0; i < 2; i++)
+        if (tmp[i] != NULL) fclose(tmp[i]);
+    free(runs);
+    free(names);
+    free(recs);
+    free(spare);
+    return status == 0 ? total : -1;
+}
+
+
+// --- GPA AGGREGATES ---
+
+// Running totals shared by the kernels. `below[k]` counts matching GPAs
+// under the (k+1)-th histogram edge; the histogram is the difference of
+// neighbouring counts, which turns binning into plain SIMD compares.
+typedef struct {
+    size_t count;
+    double sum;
+    float min, max;
+    size_t below[HIST_BINS - 1];
+} AggTotals;
+
+typedef void (*AggKernel)(const int *ids, const float *gpas, size_t n,
+                          const GpaFilter *f, AggTotals *t);
+
+// Lower edge of histogram bin `k`
+static float hist_edge(int k) {
+    return HIST_MIN + (HIST_MAX - HIST_MIN) * (float)k / HIST_BINS;
+}
+
+static void agg_scalar(const int *ids, const float *gpas, size_t n,
+                       const GpaFilter *f, AggTotals *t) {
+    for (size_t i = 0; i < n; i++) {
+        float g = gpas[i];
+        if (!(g >= f->gpa_lo && g <= f->gpa_hi)) continue;
+        if (ids != NULL && (ids[i] < f->id_lo || ids[i] > f->id_hi)) continue;
+        t->count++;
+        t->sum += g;
+        if (g < t->min) t->min = g;
+        if (g > t->max) t->max = g;
+        for (int k = 0; k < HIST_BINS - 1; k++) t->below[k] += g < hist_edge(k + 1);
+    }
+}
+
+#ifdef SMS_X86
+// Per-lane counters are 32-bit, so they are folded into the totals every
+// AGG_BLOCK rows, long before they could overflow.
+static void agg_sse2(const int *ids, const float *gpas, size_t n,
+                     const GpaFilter *f, AggTotals *t) {
+    const __m128 lo = _mm_set1_ps(f->gpa_lo), hi = _mm_set1_ps(f->gpa_hi);
+    const __m128i idlo = _mm_set1_epi32(f->id_lo), idhi = _mm_set1_epi32(f->id_hi);
+    __m128 edge[HIST_BINS - 1];
+    for (int k = 0; k < HIST_BINS - 1; k++) edge[k] = _mm_set1_ps(hist_edge(k + 1));
+    __m128 vmin = _mm_set1_ps(t->min), vmax = _mm_set1_ps(t->max);
+    __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+    size_t i = 0;
+
+    while (i + 4 <= n) {
+        size_t end = i + AGG_BLOCK < n ? i + AGG_BLOCK : n;
+        __m128i cnt = _mm_setzero_si128();
+        __m128i below[HIST_BINS - 1];
+        for (int k = 0; k < HIST_BINS - 1; k++) below[k] = _mm_setzero_si128();
+
+        for (; i + 4 <= end; i += 4) {
+            __m128 g = _mm_loadu_ps(gpas + i);
+            __m128 m = _mm_and_ps(_mm_cmpge_ps(g, lo), _mm_cmple_ps(g, hi));
+            if (ids != NULL) {
+                __m128i id = _mm_loadu_si128((const __m128i *)(ids + i));
+                __m128i out = _mm_or_si128(_mm_cmplt_epi32(id, idlo), _mm_cmpgt_epi32(id, idhi));
+                m = _mm_andnot_ps(_mm_castsi128_ps(out), m);
+            }
+            cnt = _mm_sub_epi32(cnt, _mm_castps_si128(m));
+            __m128 gm = _mm_and_ps(m, g);
+            sum0 = _mm_add_pd(sum0, _mm_cvtps_pd(gm));
+            sum1 = _mm_add_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(gm, gm)));
+            // Non-matching lanes are replaced by the current extreme
+            vmin = _mm_min_ps(vmin, _mm_or_ps(gm, _mm_andnot_ps(m, vmin)));
+            vmax = _mm_max_ps(vmax, _mm_or_ps(gm, _mm_andnot_ps(m, vmax)));
+            for (int k = 0; k < HIST_BINS - 1; k++)
+                below[k] = _mm_sub_epi32(below[k],
+                                         _mm_castps_si128(_mm_and_ps(m, _mm_cmplt_ps(g, edge[k]))));
+        }
+
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, cnt);
+        t->count += (size_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (int k = 0; k < HIST_BINS - 1; k++) {
+            _mm_storeu_si128((__m128i *)lanes, below[k]);
+            t->below[k] += (size_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+        if (end == n) break;
+    }
+
+    double sums[4];
+    float lanes_min[4], lanes_max[4];
+    _mm_storeu_pd(sums, sum0);
+    _mm_storeu_pd(sums + 2, sum1);
+    _mm_storeu_ps(lanes_min, vmin);
+    _mm_storeu_ps(lanes_max, vmax);
+    t->sum += sums[0] + sums[1] + sums[2] + sums[3];
+    for (int k = 0; k < 4; k++) {
+        if (lanes_min[k] < t->min) t->min = lanes_min[k];
+        if (lanes_max[k] > t->max) t->max = lanes_max[k];
+    }
+    agg_scalar(ids ? ids + i : NULL, gpas + i, n - i, f, t);
+}
+
+__attribute__((target("avx2")))
+static void agg_avx2(const int *ids, const float *gpas, size_t n,
+                     const GpaFilter *f, AggTotals *t) {
+    const __m256 lo = _mm256_set1_ps(f->gpa_lo), hi = _mm256_set1_ps(f->gpa_hi);
+    const __m256i idlo = _mm256_set1_epi32(f->id_lo), idhi = _mm256_set1_epi32(f->id_hi);
+    __m256 edge[HIST_BINS - 1];
+    for (int k = 0; k < HIST_BINS - 1; k++) edge[k] = _mm256_set1_ps(hist_edge(k + 1));
+    __m256 vmin = _mm256_set1_ps(t->min), vmax = _mm256_set1_ps(t->max);
+    __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+    size_t i = 0;
+
+    while (i + 8 <= n) {
+        size_t end = i + AGG_BLOCK < n ? i + AGG_BLOCK : n;
+        __m256i cnt = _mm256_setzero_si256();
+        __m256i below[HIST_BINS - 1];
+        for (int k = 0; k < HIST_BINS - 1; k++) below[k] = _mm256_setzero_si256();
+
+        for (; i + 8 <= end; i += 8) {
+            __m256 g = _mm256_loadu_ps(gpas + i);
+            __m256 m = _mm256_and_ps(_mm256_cmp_ps(g, lo, _CMP_GE_OQ), _mm256_cmp_ps(g, hi, _CMP_LE_OQ));
+            if (ids != NULL) {
+                __m256i id = _mm256_loadu_si256((const __m256i *)(ids + i));
+                __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(idlo, id), _mm256_cmpgt_epi32(id, idhi));
+                m = _mm256_andnot_ps(_mm256_castsi256_ps(out), m);
+            }
+            cnt = _mm256_sub_epi32(cnt, _mm256_castps_si256(m));
+            __m256 gm = _mm256_and_ps(m, g);
+            sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm256_castps256_ps128(gm)));
+            sum1 = _mm256_add_pd(sum1, _mm256_cvtps_pd(_mm256_extractf128_ps(gm, 1)));
+            vmin = _mm256_min_ps(vmin, _mm256_blendv_ps(vmin, g, m));
+            vmax = _mm256_max_ps(vmax, _mm256_blendv_ps(vmax, g, m));
+            for (int k = 0; k < HIST_BINS - 1; k++)
+                below[k] = _mm256_sub_epi32(below[k], _mm256_castps_si256(
+                    _mm256_and_ps(m, _mm256_cmp_ps(g, edge[k], _CMP_LT_OQ))));
+        }
+
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, cnt);
+        for (int l = 0; l < 8; l++) t->count += lanes[l];
+        for (int k = 0; k < HIST_BINS - 1; k++) {
+            _mm256_storeu_si256((__m256i *)lanes, below[k]);
+            for (int l = 0; l < 8; l++) t->below[k] += lanes[l];
+        }
+        if (end == n) break;
+    }
+
+    double sums[8];
+    float lanes_min[8], lanes_max[8];
+    _mm256_storeu_pd(sums, sum0);
+    _mm256_storeu_pd(sums + 4, sum1);
+    _mm256_storeu_ps(lanes_min, vmin);
+    _mm256_storeu_ps(lanes_max, vmax);
+    for (int k = 0; k < 8; k++) {
+        t->sum += sums[k];
+        if (lanes_min[k] < t->min) t->min = lanes_min[k];
+        if (lanes_max[k] > t->max) t->max = lanes_max[k];
+    }
+    agg_scalar(ids ? ids + i : NULL, gpas + i, n - i, f, t);
+}
+#endif
+
+// Picks the widest kernel the CPU supports
+static AggKernel agg_kernel(void) {
+#ifdef SMS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return agg_avx2;
+    if (__builtin_cpu_supports("sse2")) return agg_sse2;
+#endif
+    return agg_scalar;
+}
+
+// Chosen once; readers of a SharedStore may aggregate at the same time
+static AggKernel kernel = agg_scalar;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void pick_kernel(void) {
+    kernel = agg_kernel();
+}
+
+void gpa_aggregate(const int *ids, const float *gpas, size_t n,
+                   const GpaFilter *filter, GpaStats *out) {
+    const GpaFilter all = {-INFINITY, INFINITY, INT_MIN, INT_MAX};
+    AggTotals t;
+
+    pthread_once(&kernel_once, pick_kernel);
+    memset(&t, 0, sizeof(t));
+    t.min = INFINITY;
+    t.max = -INFINITY;
+    // Without an id range the id column is never read
+    if (filter == NULL) filter = &all;
+    if (filter->id_lo == INT_MIN && filter->id_hi == INT_MAX) ids = NULL;
+    kernel(ids, gpas, n, filter, &t);
+
+    out->count = t.count;
+    out->mean = t.count ? t.sum / (double)t.count : 0.0;
+    out->min = t.count ? t.min : 0.0f;
+    out->max = t.count ? t.max : 0.0f;
+    out->hist[0] = t.below[0];
+    for (int k = 1; k < HIST_BINS - 1; k++) out->hist[k] = t.below[k] - t.below[k - 1];
+    out->hist[HIST_BINS - 1] = t.count - t.below[HIST_BINS - 2];
+}
+
+
+
+// --- WRITE-AHEAD LOG ---
+
+// Header at the start of WAL_FILE; WalRecords and their names follow
+typedef struct {
+    char magic[4];        // WAL_MAGIC
+    uint32_t version;     // WAL_VERSION
+    uint32_t record_size; // sizeof(WalRecord) of the writer
+    uint32_t reserved;
+} WalHeader;
+
+// Longest name a log record may carry; anything longer is treated as a
+// corrupt length field
+#define WAL_NAME_MAX (1u << 20)
+
+static uint32_t wal_check(const WalRecord *r, const char *name) {
+    WalRecord copy = *r;
+    copy.check = 0;
+    uint64_t a = checksum_bytes(&copy, sizeof(copy));
+    uint64_t b = checksum_bytes(name, r->name_len);
+    return (uint32_t)(a ^ (b << 1 | b >> 63));
+}
+
+static int write_full(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Creates `path` holding a header followed by `len` bytes of records and
+// returns a descriptor open for appending. Returns -1 if `path` is
+// unchanged, or -2 if it was replaced but the rename may not survive a
+// crash; the old log is then no longer reachable through its name.
+static int wal_create(const char *path, const void *records, size_t len) {
+    char tmp[4096];
+    WalHeader hdr;
+    memcpy(hdr.magic, WAL_MAGIC, 4);
+    hdr.version = WAL_VERSION;
+    hdr.record_size = sizeof(WalRecord);
+    hdr.reserved = 0;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) return -1;
+    if (write_full(fd, &hdr, sizeof(hdr)) != 0 || write_full(fd, records, len) != 0 ||
+        fsync(fd) != 0 || rename(tmp, path) != 0) {
+        close(fd);
+        remove(tmp);
+        return -1;
+    }
+    // Until the directory is synced the rename itself may be lost
+    if (sync_parent(path) != 0) {
+        close(fd);
+        return -2;
+    }
+    return fd;
+}
+
+// Applies one PUT or DELETE to the store. Returns 0 if out of memory.
+static int apply_change(StudentStore *store, int op, const Student *rec) {
+    if (op == WAL_PUT) return store_put(store, rec);
+    store_delete(store, rec->id);
+    return 1;
+}
+
+long wal_open(Wal *wal, const char *path, StudentStore *store) {
+    WalHeader hdr;
+    WalRecord r;
+    long applied = 0;
+    char *name = NULL;
+    size_t name_cap = 0;
+    off_t good = sizeof(WalHeader);
+
+    memset(wal, 0, sizeof(*wal));
+    wal->path = path;
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_cond_init(&wal->synced, NULL);
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        // No log yet: start an empty one
+        wal->fd = wal_create(path, NULL, 0);
+        wal->size = sizeof(WalHeader);
+        if (wal->fd < 0) perror("Error creating log file");
+        return wal->fd < 0 ? -1 : 0;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || memcmp(hdr.magic, WAL_MAGIC, 4) != 0 ||
+        hdr.version != WAL_VERSION || hdr.record_size != sizeof(WalRecord)) {
+        fprintf(stderr, "%s: not a log file for this build\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    // Apply records in order; stop at the first torn or corrupt one, which
+    // can only be a write that was never acknowledged
+    while (fread(&r, sizeof(r), 1, fp) == 1 && r.name_len <= WAL_NAME_MAX) {
+        if (r.name_len + 1 > name_cap) {
+            char *grown = realloc(name, r.name_len + 1);
+            if (grown == NULL) break;
+            name = grown;
+            name_cap = r.name_len + 1;
+        }
+        if (fread(name, 1, r.name_len, fp) != r.name_len || r.check != wal_check(&r, name))
+            break;
+        name[r.name_len] = '\0';
+
+        Student rec = {name, r.id, r.gpa};
+        if (!apply_change(store, (int)r.op, &rec)) {
+            fprintf(stderr, "Out of memory replaying %s\n", path);
+            free(name);
+            fclose(fp);
+            return -1;
+        }
+        applied++;
+        good += (off_t)(sizeof(r) + r.name_len);
+    }
+    free(name);
+    fclose(fp);
+
+    wal->records = (size_t)applied;
+    wal->size = good;
+    wal->fd = open(path, O_WRONLY | O_APPEND);
+    // Cut off any partial tail so new records follow the last good one
+    if (wal->fd < 0 || ftruncate(wal->fd, wal->size) != 0) {
+        perror("Error opening log file");
+        return -1;
+    }
+    return applied;
+}
+
+void wal_close(Wal *wal) {
+    wal_sync(wal, wal->appended);
+    wal_poll_compaction(wal, 1);
+    if (wal->fd >= 0) close(wal->fd);
+    free(wal->buf);
+    pthread_cond_destroy(&wal->synced);
+    pthread_mutex_destroy(&wal->lock);
+}
+
+uint64_t wal_append(Wal *wal, int op, const Student *rec) {
+    // Deletes only need the id
+    const char *name = op == WAL_PUT ? rec->name : "";
+    size_t name_len = strlen(name);
+    // Replay would take such a record for a corrupt tail, so it never gets in
+    if (name_len > WAL_NAME_MAX) return 0;
+    WalRecord r;
+    r.op = (uint32_t)op;
+    r.id = rec->id;
+    r.gpa = op == WAL_PUT ? rec->gpa : 0.0f;
+    r.name_len = (uint32_t)name_len;
+    r.check = wal_check(&r, name);
+
+    pthread_mutex_lock(&wal->lock);
+    size_t need = wal->len + sizeof(r) + name_len;
+    if (need > wal->cap) {
+        size_t cap = 2 * need;
+        char *buf = realloc(wal->buf, cap);
+        if (buf == NULL) {
+            wal->failed = 1;
+        } else {
+            wal->buf = buf;
+            wal->cap = cap;
+        }
+    }
+    if (wal->failed) {
+        pthread_mutex_unlock(&wal->lock);
+        return wal->appended;
+    }
+    memcpy(wal->buf + wal->len, &r, sizeof(r));
+    memcpy(wal->buf + wal->len + sizeof(r), name, name_len);
+    wal->len = need;
+    wal->buffered++;
+    uint64_t seq = ++wal->appended;
+    pthread_mutex_unlock(&wal->lock);
+    return seq;
+}
+
+int wal_sync(Wal *wal, uint64_t seq) {
+    pthread_mutex_lock(&wal->lock);
+    while (wal->durable < seq && !wal->failed) {
+        if (wal->syncing) {
+            // Someone else is syncing; our record is in their batch or the next
+            pthread_cond_wait(&wal->synced, &wal->lock);
+            continue;
+        }
+        // Become the leader: take everything buffered and make it durable
+        char *batch = wal->buf;
+        size_t n = wal->len;
+        size_t nrecords = wal->buffered;
+        uint64_t upto = wal->appended;
+        int fd = wal->fd;
+        wal->buf = NULL;
+        wal->len = wal->cap = 0;
+        wal->buffered = 0;
+        wal->syncing = 1;
+        pthread_mutex_unlock(&wal->lock);
+
+        int err = write_full(fd, batch, n) != 0 || fdatasync(fd) != 0;
+        free(batch);
+
+        pthread_mutex_lock(&wal->lock);
+        wal->syncing = 0;
+        if (err) {
+            wal->failed = 1;
+        } else {
+            wal->durable = upto;
+            wal->size += (off_t)n;
+            wal->records += nrecords;
+        }
+        pthread_cond_broadcast(&wal->synced);
+    }
+    int failed = wal->failed;
+    pthread_mutex_unlock(&wal->lock);
+    return failed ? -1 : 0;
+}
+
+int wal_log(Wal *wal, int op, const Student *rec) {
+    uint64_t seq = wal_append(wal, op, rec);
+    return seq == 0 ? -1 : wal_sync(wal, seq);
+}
+
+// With wal->lock held, waits until no group commit leader is writing to or
+// syncing wal->fd. Until the lock is released no new one can start, so the
+// caller may replace the file.
+static void wal_quiesce(Wal *wal) {
+    while (wal->syncing) pthread_cond_wait(&wal->synced, &wal->lock);
+}
+
+int wal_reset(Wal *wal) {
+    wal_poll_compaction(wal, 1);
+    pthread_mutex_lock(&wal->lock);
+    wal_quiesce(wal);
+    int fd = wal_create(wal->path, NULL, 0);
+    if (fd == -2) wal->failed = 1;
+    if (fd >= 0) {
+        close(wal->fd);
+        wal->fd = fd;
+        wal->size = sizeof(WalHeader);
+        wal->records = 0;
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return fd < 0 ? -1 : 0;
+}
+
+void wal_compact(Wal *wal, const StudentStore *store) {
+    if (wal->compactor != 0) return;
+    if (wal_sync(wal, wal->appended) != 0) return;
+
+    fflush(NULL);
+    wal->compact_from = wal->size;
+    wal->compact_records = wal->records;
+    // The child gets a copy-on-write image of the store as of this point and
+    // writes it out while the parent keeps accepting (and logging) changes
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(save_students(store, DATA_FILE) == 0 ? 0 : 1);
+    if (pid < 0)
+        perror("Error starting compaction");
+    else
+        wal->compactor = pid;
+}
+
+void wal_poll_compaction(Wal *wal, int wait) {
+    int status;
+    if (wal->compactor == 0) return;
+    if (waitpid(wal->compactor, &status, wait ? 0 : WNOHANG) <= 0) return;
+    wal->compactor = 0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Compaction failed; %s keeps all changes.\n", wal->path);
+        return;
+    }
+
+    // DATA_FILE now covers the log up to compact_from; keep only the tail.
+    // If we crash before the rename, replaying the whole log is still
+    // correct because every record is idempotent.
+    pthread_mutex_lock(&wal->lock);
+    // A batch still being written would be copied half done or missed
+    wal_quiesce(wal);
+    size_t tail = (size_t)(wal->size - wal->compact_from);
+    char *buf = malloc(tail ? tail : 1);
+    int fd = -1;
+    int in = open(wal->path, O_RDONLY);
+    if (buf != NULL && in >= 0 && pread(in, buf, tail, wal->compact_from) == (ssize_t)tail)
+        fd = wal_create(wal->path, buf, tail);
+    if (in >= 0) close(in);
+    free(buf);
+    // Appends to the old descriptor would go to a file that is gone
+    if (fd == -2) wal->failed = 1;
+    if (fd >= 0) {
+        close(wal->fd);
+        wal->fd = fd;
+        wal->size = (off_t)(sizeof(WalHeader) + tail);
+        wal->records -= wal->compact_records;
+    }
+    pthread_mutex_unlock(&wal->lock);
+}
+
+void wal_maybe_compact(Wal *wal, const StudentStore *store) {
+    if (wal->records >= COMPACT_MIN && wal->records > store->count / 2)
+        wal_compact(wal, store);
+}
+
+
+// --- SHARED STORE ---
+
+// Copies every record of `src` into the empty store `dst`. Returns 0 if out
+// of memory.
+static int store_copy(StudentStore *dst, const StudentStore *src) {
+    Student rec;
+
+    if (!store_reserve(dst, src->count)) return 0;
+    for (size_t i = 0; i < src->count; i++) {
+        store_get(src, i, &rec);
+        if (store_add(dst, &rec) < 0) return 0;
+    }
+    return 1;
+}
+
+int shared_open(SharedStore *shared, StudentStore *store) {
+    memset(shared, 0, sizeof(*shared));
+    atomic_init(&shared->current, 0);
+    atomic_init(&shared->epoch, 1);
+    for (int i = 0; i < MAX_READERS; i++) {
+        atomic_init(&shared->readers[i].epoch, 0);
+        atomic_init(&shared->readers[i].in_use, 0);
+    }
+
+    store_init(&shared->copy[1]);
+    if (!store_copy(&shared->copy[1], store)) {
+        store_free(&shared->copy[1]);
+        return -1;
+    }
+    shared->copy[0] = *store;
+    store_init(store);
+    return 0;
+}
+
+void shared_close(SharedStore *shared, StudentStore *store) {
+    int latest = 1 - atomic_load(&shared->current);
+    if (store != NULL) {
+        *store = shared->copy[latest];
+        store_init(&shared->copy[latest]);
+    }
+    store_free(&shared->copy[0]);
+    store_free(&shared->copy[1]);
+    free(shared->pending);
+    shared->pending = NULL;
+}
+
+int shared_reader_register(SharedStore *shared) {
+    for (int i = 0; i < MAX_READERS; i++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&shared->readers[i].in_use, &expected, 1))
+            return i;
+    }
+    return -1;
+}
+
+void shared_reader_unregister(SharedStore *shared, int reader) {
+    atomic_store(&shared->readers[reader].in_use, 0);
+}
+
+const StudentStore *shared_read_begin(SharedStore *shared, int reader) {
+    // Announce the epoch before looking at `current`. Both are sequentially
+    // consistent, so a publish that misses the announcement has already
+    // switched `current` and this reader picks up the new copy.
+    atomic_store(&shared->readers[reader].epoch, atomic_load(&shared->epoch));
+    return &shared->copy[atomic_load(&shared->current)];
+}
+
+void shared_read_end(SharedStore *shared, int reader) {
+    atomic_store_explicit(&shared->readers[reader].epoch, 0, memory_order_release);
+}
+
+const StudentStore *shared_latest(const SharedStore *shared) {
+    return &shared->copy[1 - atomic_load(&shared->current)];
+}
+
+// Applies a change to the writer's copy and queues it for the other one
+static int shared_change(SharedStore *shared, int op, const Student *rec) {
+    const char *name = op == WAL_PUT ? rec->name : "";
+    size_t name_len = strlen(name);
+    WalRecord r = {(uint32_t)op, 0, rec->id, rec->gpa, (uint32_t)name_len};
+
+    if (shared->failed || name_len > UINT32_MAX - 1) return 0;
+    size_t need = shared->len + sizeof(r) + name_len + 1;
+    if (need > shared->cap) {
+        char *buf = realloc(shared->pending, 2 * need);
+        if (buf == NULL) return 0;
+        shared->pending = buf;
+        shared->cap = 2 * need;
+    }
+    if (!apply_change(&shared->copy[1 - atomic_load(&shared->current)], op, rec))
+        return 0;
+    memcpy(shared->pending + shared->len, &r, sizeof(r));
+    memcpy(shared->pending + shared->len + sizeof(r), name, name_len + 1);
+    shared->len = need;
+    shared->changes++;
+    return 1;
+}
+
+int shared_put(SharedStore *shared, const Student *rec) {
+    return shared_change(shared, WAL_PUT, rec);
+}
+
+int shared_delete(SharedStore *shared, int id) {
+    Student rec = {"", id, 0.0f};
+    return shared_change(shared, WAL_DELETE, &rec);
+}
+
+int shared_publish(SharedStore *shared) {
+    if (shared->failed) return -1;
+    if (shared->changes == 0) return 0;
+
+    // Point new readers at the writer's copy, then wait until every reader
+    // that may still be using the retired one has left its read section
+    int old = atomic_load(&shared->current);
+    atomic_store(&shared->current, 1 - old);
+    uint64_t epoch = atomic_fetch_add(&shared->epoch, 1) + 1;
+    for (int i = 0; i < MAX_READERS; i++) {
+        uint64_t seen;
+        while ((seen = atomic_load(&shared->readers[i].epoch)) != 0 && seen < epoch)
+            sched_yield();
+    }
+
+    // The retired copy is now the writer's: bring it up to date
+    StudentStore *store = &shared->copy[old];
+    for (size_t off = 0; off < shared->len;) {
+        WalRecord r;
+        memcpy(&r, shared->pending + off, sizeof(r));
+        off += sizeof(r);
+        Student rec = {shared->pending + off, r.id, r.gpa};
+        off += r.name_len + 1;
+        if (!apply_change(store, (int)r.op, &rec)) {
+            shared->failed = 1;
+            return -1;
+        }
+    }
+    shared->len = 0;
+    shared->changes = 0;
+    return 0;
+}
+
+
+// State shared by import_with_progress() and its loader thread
+typedef struct {
+    SharedStore *shared;
+    const char *path;
+    RecordFormat format;
+    size_t unpublished;     // records added since the last publish
+    long added;             // result of import_each()
+    int done;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} LiveImport;
+
+static int live_import_add(void *ctx, const Student *rec) {
+    LiveImport *li = ctx;
+
+    if (store_find(shared_latest(li->shared), rec->id) != NOT_FOUND) return 0;
+    if (!shared_put(li->shared, rec)) return -1;
+    if (++li->unpublished == IMPORT_PUBLISH) {
+        if (shared_publish(li->shared) != 0) return -1;
+        li->unpublished = 0;
+    }
+    return 1;
+}
+
+// The only writer of li->shared while it runs
+static void *live_import_loader(void *arg) {
+    LiveImport *li = arg;
+
+    li->added = import_each(li->path, li->format, live_import_add, li);
+    shared_publish(li->shared);
+    pthread_mutex_lock(&li->lock);
+    li->done = 1;
+    pthread_cond_signal(&li->finished);
+    pthread_mutex_unlock(&li->lock);
+    return NULL;
+}
+
+long import_with_progress(StudentStore *store, const char *path, RecordFormat format) {
+    SharedStore shared;
+    pthread_t loader;
+
+    // Without room for a second copy, import the plain way
+    if (shared_open(&shared, store) != 0)
+        return import_records(store, path, format);
+
+    LiveImport li = {&shared, path, format, 0, 0, 0,
+                     PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+    size_t before = shared_latest(&shared)->count;
+    int reader = shared_reader_register(&shared);
+    if (reader < 0 || pthread_create(&loader, NULL, live_import_loader, &li) != 0) {
+        live_import_loader(&li);
+    } else {
+        // Once a second, show what readers can already see
+        pthread_mutex_lock(&li.lock);
+        while (!li.done) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_sec += 1;
+            if (pthread_cond_timedwait(&li.finished, &li.lock, &until) == 0 || li.done)
+                continue;
+            const StudentStore *snap = shared_read_begin(&shared, reader);
+            GpaStats st;
+            gpa_aggregate(NULL, snap->gpas, snap->count, NULL, &st);
+            fprintf(stderr, "Importing %s: %zu record(s) so far, mean GPA %.2f\n", path,
+                    snap->count - before, st.mean);
+            shared_read_end(&shared, reader);
+        }
+        pthread_mutex_unlock(&li.lock);
+        pthread_join(loader, NULL);
+    }
+    if (reader >= 0) shared_reader_unregister(&shared, reader);
+    shared_close(&shared, store);
+    pthread_cond_destroy(&li.finished);
+    pthread_mutex_destroy(&li.lock);
+
+    // Give back the growth slack now that the size is known
+    store_shrink(store);
+    return li.added;
+}
+
+
+
+
+// Logs a change and only then applies it, so the store never holds a
+// change the log lacks (compaction would otherwise write it out). If the
+// store runs out of memory, `undo` (the state before, or NULL if applying
+// cannot fail) is logged so the log matches the store again. Returns 0 on
+// success, -1 if the log could not be written and -2 if out of memory.
+static int log_and_apply(StudentStore *store, Wal *wal, int op, const Student *rec,
+                         int undo_op, const Student *undo) {
+    if (wal_log(wal, op, rec) != 0) return -1;
+    if (!apply_change(store, op, rec)) {
+        wal_log(wal, undo_op, undo);
+        return -2;
+    }
+    wal_maybe_compact(wal, store);
+    return 0;
+}
+
+// Read input from user and append to the store
+void add_student(StudentStore *store, Wal *wal) {
+    Student s;
+
+    printf("\n--- Add New Student ---\n");
+
+    // Get Name; the whole line is used, so it may contain spaces
+    char *name = read_name("Enter Name: ");
+    if (name == NULL) return;
+    if (strlen(name) > WAL_NAME_MAX) {
+        printf("\n** ERROR: Names are limited to %u bytes. **\n\n", WAL_NAME_MAX);
+        free(name);
+        return;
+    }
+    s.name = name;
+
+    // Get ID, rejecting ones that are already taken
+    s.id = read_id("Enter ID: ");
+    if (store_find(store, s.id) != NOT_FOUND) {
+        printf("\n** ERROR: A student with ID %d already exists. **\n\n", s.id);
+        free(name);
+        return;
+    }
+
+    // Get GPA
+    printf("Enter GPA: ");
+    while (scanf("%f", &s.gpa) != 1 || s.gpa < 0.0 || s.gpa > 4.0) {
+        printf("Invalid input. Please enter a GPA between 0.0 and 4.0: ");
+        while (getchar() != '\n');
+    }
+    // Clear newline character from buffer
+    while (getchar() != '\n');
+
+    // Only report success once the change is on disk
+    Student undo = {"", s.id, 0.0f};
+    int status = log_and_apply(store, wal, WAL_PUT, &s, WAL_DELETE, &undo);
+    free(name);
+    if (status == -1) {
+        printf("\n** ERROR: Could not write %s; the record is not saved. **\n\n", WAL_FILE);
+        return;
+    }
+    if (status == -2) {
+        printf("\n** ERROR: Out of memory. Cannot add more students. **\n");
+        return;
+    }
+
+    printf("Student record added successfully!\n\n");
+}
+
+
+// Print one record as a table row
+static void print_row(const StudentStore *store, size_t pos) {
+    printf("%-5d | %-20s | %.2f\n", store->ids[pos], store_name(store, pos), store->gpas[pos]);
+}
+
+
+// Print all student records
+void list_students(const StudentStore *store) {
+    size_t i;
+
+    printf("\n--- Student List (%zu Records) ---\n", store->count);
+
+    if (store->count == 0) {
+        printf("No students currently in the system.\n");
+        printf("---------------------------------\n\n");
+        return;
+    }
+
+    // Print Header
+    printf("%-5s | %-20s | %s\n", "ID", "Name", "GPA");
+    printf("----------------------------------------\n");
+
+    // Print each student record
+    for (i = 0; i < store->count; i++)
+        print_row(store, i);
+
+    printf("----------------------------------------\n\n");
+}
+
+// Read an integer id, re-prompting until one is entered
+int read_id(const char *prompt) {
+    int id;
+
+    printf("%s", prompt);
+    while (scanf("%d", &id) != 1) {
+        printf("Invalid input. Please enter an integer for ID: ");
+        while (getchar() != '\n');
+    }
+    // Clear newline character from buffer
+    while (getchar() != '\n');
+
+    return id;
+}
+
+
+// Read a whole line, trimming surrounding whitespace
+char *read_name(const char *prompt) {
+    char *line = NULL;
+    size_t cap = 0;
+
+    printf("%s", prompt);
+    for (;;) {
+        if (getline(&line, &cap, stdin) == -1) {
+            free(line);
+            return NULL;
+        }
+        char *start = line;
+        char *end = line + strlen(line);
+        while (end > start && isspace((unsigned char)end[-1])) end--;
+        *end = '\0';
+        while (isspace((unsigned char)*start)) start++;
+        if (*start != '\0') {
+            memmove(line, start, (size_t)(end - start) + 1);
+            return line;
+        }
+        printf("Name cannot be empty. Please enter a name: ");
+    }
+}
+
+
+// Print the record for one id
+void find_student(const StudentStore *store) {
+    int id = read_id("\nEnter ID to find: ");
+    size_t pos = store_find(store, id);
+
+    if (pos == NOT_FOUND) {
+        printf("No student with ID %d.\n\n", id);
+        return;
+    }
+    printf("%-5s | %-20s | %s\n", "ID", "Name", "GPA");
+    print_row(store, pos);
+    printf("\n");
+}
+
+
+// Replace the name and GPA of one record; the id stays the same
+void update_student(StudentStore *store, Wal *wal) {
+    int id = read_id("\nEnter ID to update: ");
+    size_t pos = store_find(store, id);
+    Student s;
+
+    if (pos == NOT_FOUND) {
+        printf("No student with ID %d.\n\n", id);
+        return;
+    }
+
+    char *name = read_name("Enter new Name: ");
+    if (name == NULL) return;
+    if (strlen(name) > WAL_NAME_MAX) {
+        printf("\n** ERROR: Names are limited to %u bytes. **\n\n", WAL_NAME_MAX);
+        free(name);
+        return;
+    }
+    s.name = name;
+
+    printf("Enter new GPA: ");
+    while (scanf("%f", &s.gpa) != 1 || s.gpa < 0.0 || s.gpa > 4.0) {
+        printf("Invalid input. Please enter a GPA between 0.0 and 4.0: ");
+        while (getchar() != '\n');
+    }
+    // Clear newline character from buffer
+    while (getchar() != '\n');
+
+    // The old name may live in the file mapping, which a change can unmap
+    s.id = id;
+    Student old;
+    store_get(store, pos, &old);
+    char *old_name = malloc(strlen(old.name) + 1);
+    int status = -2;
+    if (old_name != NULL) {
+        strcpy(old_name, old.name);
+        old.name = old_name;
+        status = log_and_apply(store, wal, WAL_PUT, &s, WAL_PUT, &old);
+    }
+    free(old_name);
+    free(name);
+    if (status == -1) {
+        printf("\n** ERROR: Could not write %s; the change is not saved. **\n\n", WAL_FILE);
+        return;
+    }
+    if (status == -2) {
+        printf("\n** ERROR: Out of memory. The record was not changed. **\n\n");
+        return;
+    }
+    printf("Student record updated successfully!\n\n");
+}
+
+
+// Remove one record
+void delete_student(StudentStore *store, Wal *wal) {
+    int id = read_id("\nEnter ID to delete: ");
+    Student key;
+
+    if (store_find(store, id) == NOT_FOUND) {
+        printf("No student with ID %d.\n\n", id);
+        return;
+    }
+    memset(&key, 0, sizeof(key));
+    key.name = "";
+    key.id = id;
+    // Deleting cannot run out of memory, so there is nothing to undo
+    if (log_and_apply(store, wal, WAL_DELETE, &key, WAL_DELETE, NULL) != 0) {
+        printf("\n** ERROR: Could not write %s; the change is not saved. **\n\n", WAL_FILE);
+        return;
+    }
+    printf("Student %d deleted.\n\n", id);
+}
+
+
+// Print one index entry as a table row
+static void print_gpa_row(const StudentStore *store, uint64_t key) {
+    print_row(store, store_find(store, gpa_key_id(key)));
+}
+
+
+// Print every student with lo <= GPA <= hi, highest GPA first
+void gpa_range_query(StudentStore *store) {
+    float lo, hi;
+
+    printf("\nEnter GPA range (min max): ");
+    while (scanf("%f %f", &lo, &hi) != 2 || lo > hi) {
+        printf("Invalid input. Please enter two numbers, min <= max: ");
+        while (getchar() != '\n');
+    }
+    // Clear newline character from buffer
+    while (getchar() != '\n');
+
+    const GpaIndex *gpa = store_gpa_index(store);
+    if (gpa == NULL) {
+        printf("\n** ERROR: Out of memory building the GPA index. **\n\n");
+        return;
+    }
+    // [first, last) spans every id at GPAs lo..hi
+    size_t first = gpa_lower_bound(gpa, gpa_key(lo, INT32_MIN));
+    size_t last = gpa_lower_bound(gpa, gpa_key(hi, INT32_MAX) + 1);
+
+    printf("\n--- Students with GPA %.2f to %.2f (%zu Records) ---\n", lo, hi, last - first);
+    printf("%-5s | %-20s | %s\n", "ID", "Name", "GPA");
+    printf("----------------------------------------\n");
+    for (size_t i = last; i > first; i--)
+        print_gpa_row(store, gpa->keys[i - 1]);
+    printf("----------------------------------------\n\n");
+}
+
+
+// Print the K highest GPAs (ties broken by higher id)
+void top_students(StudentStore *store) {
+    int k;
+
+    printf("\nHow many students? ");
+    while (scanf("%d", &k) != 1 || k <= 0) {
+        printf("Invalid input. Please enter a positive integer: ");
+        while (getchar() != '\n');
+    }
+    // Clear newline character from buffer
+    while (getchar() != '\n');
+
+    const GpaIndex *gpa = store_gpa_index(store);
+    if (gpa == NULL) {
+        printf("\n** ERROR: Out of memory building the GPA index. **\n\n");
+        return;
+    }
+    size_t n = (size_t)k < gpa->count ? (size_t)k : gpa->count;
+
+    printf("\n--- Top %zu Students by GPA ---\n", n);
+    printf("%-5s | %-20s | %s\n", "ID", "Name", "GPA");
+    printf("----------------------------------------\n");
+    for (size_t i = 0; i < n; i++)
+        print_gpa_row(store, gpa->keys[gpa->count - 1 - i]);
+    printf("----------------------------------------\n\n");
+}
+
+
+// Print the result of gpa_aggregate()
+static void print_gpa_stats(const GpaStats *st) {
+    printf("\n--- GPA Statistics (%zu Matching Records) ---\n", st->count);
+    if (st->count > 0) {
+        printf("Mean: %.3f   Min: %.2f   Max: %.2f\n", st->mean, st->min, st->max);
+        for (int k = 0; k < HIST_BINS; k++) {
+            float lo = HIST_MIN + (HIST_MAX - HIST_MIN) * (float)k / HIST_BINS;
+            float hi = HIST_MIN + (HIST_MAX - HIST_MIN) * (float)(k + 1) / HIST_BINS;
+            printf("%.2f-%.2f | %zu\n", lo, hi, st->hist[k]);
+        }
+    }
+    printf("----------------------------------------\n\n");
+}
+
+
+// Read an optional filter and print aggregate GPA figures
+void gpa_statistics(const StudentStore *store) {
+    GpaFilter filter = {-INFINITY, INFINITY, INT_MIN, INT_MAX};
+    GpaStats st;
+    char answer[8];
+
+    printf("\nFilter by GPA and ID range? (y/n): ");
+    scanf("%7s", answer);
+    while (getchar() != '\n');
+    if (answer[0] == 'y' || answer[0] == 'Y') {
+        printf("Enter GPA range (min max): ");
+        while (scanf("%f %f", &filter.gpa_lo, &filter.gpa_hi) != 2 || filter.gpa_lo > filter.gpa_hi) {
+            printf("Invalid input. Please enter two numbers, min <= max: ");
+            while (getchar() != '\n');
+        }
+        while (getchar() != '\n');
+        printf("Enter ID range (min max): ");
+        while (scanf("%d %d", &filter.id_lo, &filter.id_hi) != 2 || filter.id_lo > filter.id_hi) {
+            printf("Invalid input. Please enter two integers, min <= max: ");
+            while (getchar() != '\n');
+        }
+        while (getchar() != '\n');
+    }
+
+    gpa_aggregate(store->ids, store->gpas, store->count, &filter, &st);
+    print_gpa_stats(&st);
+}
+
+
+// --- COMMAND LINE ---
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [COMMAND]\n"
+            "Without a command the interactive menu runs. Commands:\n"
+            "  import FILE [FORMAT]   add the records in FILE\n"
+            "  export FILE [FORMAT]   write all records to FILE\n"
+            "  get ID...              print the records with these IDs\n"
+            "  stats [GPA_MIN GPA_MAX [ID_MIN ID_MAX]]\n"
+            "                         GPA statistics, optionally filtered\n"
+            "  sort IN OUT [id|name|gpa [MEMORY_MB [THREADS]]]\n"
+            "                         sort a file of any size (default: by id,\n"
+            "                         %d MiB, one thread per CPU)\n"
+            "FORMAT is text, csv or tsv; by default it follows the extension of\n"
+            "FILE (.csv, .tsv, otherwise text). FILE - is stdin or stdout.\n",
+            prog, SORT_DEFAULT_MB);
+}
+
+// Format named on the command line, or the one implied by the file name
+static int command_format(int argc, char **argv, RecordFormat *format) {
+    if (argc == 3) {
+        *format = format_of(argv[2]);
+        return 1;
+    }
+    if (argc != 4) return 0;
+    if (strcmp(argv[3], "text") == 0) *format = FORMAT_TEXT;
+    else if (strcmp(argv[3], "csv") == 0) *format = FORMAT_CSV;
+    else if (strcmp(argv[3], "tsv") == 0) *format = FORMAT_TSV;
+    else return 0;
+    return 1;
+}
+
+// Dispatch one subcommand
+int run_command(StudentStore *store, Wal *wal, int argc, char **argv) {
+    const char *cmd = argv[1];
+    RecordFormat format;
+
+    if (strcmp(cmd, "import") == 0 && command_format(argc, argv, &format)) {
+        long added = import_with_progress(store, argv[2], format);
+        // Bulk loads go straight into a new DATA_FILE, not the log
+        if (added < 0 || save_students(store, DATA_FILE) != 0 || wal_reset(wal) != 0)
+            return EXIT_FAILURE;
+        printf("Imported %ld record(s) from %s into %s.\n", added, argv[2], DATA_FILE);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(cmd, "export") == 0 && command_format(argc, argv, &format)) {
+        if (export_records(store, argv[2], format) != 0)
+            return EXIT_FAILURE;
+        // Keep stdout clean when the records themselves went there
+        if (strcmp(argv[2], "-") != 0)
+            printf("Exported %zu record(s) to %s.\n", store->count, argv[2]);
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(cmd, "get") == 0 && argc >= 3) {
+        int status = EXIT_SUCCESS;
+        printf("%-5s | %-20s | %s\n", "ID", "Name", "GPA");
+        for (int i = 2; i < argc; i++) {
+            int id;
+            size_t pos = NOT_FOUND;
+            if (parse_id(argv[i], &id)) pos = store_find(store, id);
+            if (pos == NOT_FOUND) {
+                fprintf(stderr, "No student with ID %s.\n", argv[i]);
+                status = EXIT_FAILURE;
+                continue;
+            }
+            print_row(store, pos);
+        }
+        return status;
+    }
+
+    if (strcmp(cmd, "stats") == 0 && (argc == 2 || argc == 4 || argc == 6)) {
+        GpaFilter filter = {-INFINITY, INFINITY, INT_MIN, INT_MAX};
+        GpaStats st;
+        if ((argc >= 4 && (!parse_gpa(argv[2], &filter.gpa_lo) ||
+                           !parse_gpa(argv[3], &filter.gpa_hi))) ||
+            (argc == 6 && (!parse_id(argv[4], &filter.id_lo) ||
+                           !parse_id(argv[5], &filter.id_hi)))) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        gpa_aggregate(store->ids, store->gpas, store->count, &filter, &st);
+        print_gpa_stats(&st);
+        return EXIT_SUCCESS;
+    }
+
+    usage(argv[0]);
+    return EXIT_FAILURE;
+}
+
+int sort_command(int argc, char **argv) {
+    if (argc >= 4 && argc <= 7) {
+        SortKey key = SORT_ID;
+        int mb = SORT_DEFAULT_MB;
+        int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (argc >= 5) {
+            if (strcmp(argv[4], "id") == 0) key = SORT_ID;
+            else if (strcmp(argv[4], "name") == 0) key = SORT_NAME;
+            else if (strcmp(argv[4], "gpa") == 0) key = SORT_GPA;
+            else mb = -1;
+        }
+        if ((argc >= 6 && (!parse_id(argv[5], &mb) || mb <= 0)) ||
+            (argc == 7 && (!parse_id(argv[6], &threads) || threads <= 0)) || mb <= 0) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        long sorted = sort_records(argv[2], format_of(argv[2]), argv[3], format_of(argv[3]), key,
+                                   (size_t)mb << 20, threads);
+        if (sorted < 0)
+            return EXIT_FAILURE;
+        if (strcmp(argv[3], "-") != 0)
+            printf("Sorted %ld record(s) into %s.\n", sorted, argv[3]);
+        return EXIT_SUCCESS;
+    }
+
+    usage(argv[0]);
+    return EXIT_FAILURE;
+}
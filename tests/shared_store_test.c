@@ -0,0 +1,93 @@
+// Runs reader threads against a SharedStore while its writer keeps
+// changing it, and checks that every read section sees one published state.
+// Build with `make test` (add -fsanitize=thread to CFLAGS to race-check).
+#define main sms_main
+#include "../src/week5_task3_student_management_system.c"
+#undef main
+
+#define BASE 2000       // records present from the start
+#define BATCHES 200     // publishes made by the writer
+#define READERS 4
+
+static SharedStore shared;
+static atomic_int writer_done;
+
+// After batch b every one of the BASE + b records has GPA b / 100 and the
+// name "b<b>", so a reader can tell from the count which batch it sees.
+static void *writer(void *arg) {
+    char name[32];
+    (void)arg;
+
+    for (int b = 1; b <= BATCHES; b++) {
+        Student rec = {name, 0, (float)b / 100};
+        snprintf(name, sizeof(name), "b%d", b);
+        for (int id = 1; id < BASE + b; id++) {
+            rec.id = id;
+            if (!shared_put(&shared, &rec)) abort();
+        }
+        rec.id = BASE + b;
+        if (!shared_put(&shared, &rec)) abort();
+        // Deleted and put back, so readers would see it missing if a
+        // batch leaked out half applied
+        if (!shared_delete(&shared, 1) || !shared_put(&shared, &(Student){name, 1, rec.gpa}))
+            abort();
+        if (shared_publish(&shared) != 0) abort();
+    }
+    atomic_store(&writer_done, 1);
+    return NULL;
+}
+
+static void *reader(void *arg) {
+    long *errors = arg;
+    int slot = shared_reader_register(&shared);
+    int last = 0;
+    char want[32];
+
+    if (slot < 0) abort();
+    while (!atomic_load(&writer_done)) {
+        const StudentStore *snap = shared_read_begin(&shared, slot);
+        int b = (int)(snap->count - BASE);
+        GpaStats st;
+        gpa_aggregate(NULL, snap->gpas, snap->count, NULL, &st);
+        size_t pos = store_find(snap, 1);
+        snprintf(want, sizeof(want), "b%d", b);
+        if (b < last || b > BATCHES || st.min != st.max || st.min != (float)b / 100 ||
+            pos == NOT_FOUND || strcmp(store_name(snap, pos), want) != 0)
+            (*errors)++;
+        last = b;
+        shared_read_end(&shared, slot);
+    }
+    shared_reader_unregister(&shared, slot);
+    return NULL;
+}
+
+int main(void) {
+    StudentStore store;
+    pthread_t w, r[READERS];
+    long errors[READERS] = {0};
+
+    store_init(&store);
+    for (int id = 1; id <= BASE; id++)
+        if (store_add(&store, &(Student){"b0", id, 0.0f}) != 1) abort();
+    if (shared_open(&shared, &store) != 0) abort();
+
+    for (int i = 0; i < READERS; i++) pthread_create(&r[i], NULL, reader, &errors[i]);
+    pthread_create(&w, NULL, writer, NULL);
+    pthread_join(w, NULL);
+    long total = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(r[i], NULL);
+        total += errors[i];
+    }
+
+    // The writer's copy comes back with every batch in it
+    char want[32];
+    shared_close(&shared, &store);
+    snprintf(want, sizeof(want), "b%d", BATCHES);
+    size_t pos = store_find(&store, BASE + BATCHES);
+    int ok = total == 0 && store.count == BASE + BATCHES && pos != NOT_FOUND &&
+             strcmp(store_name(&store, pos), want) == 0;
+    store_free(&store);
+    printf("shared_store_test: %s (%ld inconsistent read(s))\n", ok ? "ok" : "FAILED", total);
+    return ok ? 0 : 1;
+}